@@ -0,0 +1,65 @@
+/**
+ *
+ * @file batch.cpp
+ * Runs every scenario of a manifest (see load_manifest) on a pool of threads.
+ *
+ */
+
+#include "batch.hpp"
+
+int main(int argc, char** argv) {
+    if(argc < 2) {
+        std::cout << "ERROR!\nExpected a manifest" << std::endl;
+        std::cout << "To run the batch, do: ./batch <your_manifest.txt> [--threads=<count>] [--output-dir=<directory>]" << std::endl;
+        exit(1);
+    }
+
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    std::string output_dir = ".";
+    for(int i = 2; i < argc; i++) {
+        std::string_view option(argv[i]);
+        size_t equals = option.find('=');
+        std::string_view name = option.substr(0, equals);
+        std::string_view value = equals == std::string_view::npos ? std::string_view() : option.substr(equals + 1);
+
+        if(name == "--threads") {
+            if(!parse_positive(value, threads)) {
+                std::cerr << "Error: Invalid thread count '" << value << "'" << std::endl;
+                exit(1);
+            }
+        } else if(name == "--output-dir" && !value.empty()) {
+            output_dir = value;
+        } else {
+            std::cerr << "Error: Unknown option: " << option << std::endl;
+            exit(1);
+        }
+    }
+
+    std::vector<scenario_t> scenarios = load_manifest(argv[1]);
+    std::filesystem::create_directories(output_dir);
+
+    auto start = std::chrono::steady_clock::now();
+    program_cache_t cache;
+    std::vector<scenario_result_t> results = run_batch(scenarios, output_dir, threads, cache);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    int failed = 0;
+    for(size_t i = 0; i < scenarios.size(); i++) {
+        const scenario_result_t& result = results[i];
+        std::cout << std::left << std::setw(20) << scenarios[i].name << std::right;
+        if(result.ok) {
+            std::cout << " ok      end time " << std::setw(8) << result.end_time
+                      << "  " << std::fixed << std::setprecision(3) << result.seconds * 1000 << " ms" << std::endl;
+        } else {
+            std::cout << " FAILED  " << result.error << std::endl;
+            failed++;
+        }
+    }
+    std::cout << scenarios.size() << " scenario(s), " << failed << " failed, " << threads << " thread(s), "
+              << std::fixed << std::setprecision(3) << seconds << " s" << std::endl;
+    std::cout << "Program cache: " << cache.hits << " hit(s), " << cache.misses << " miss(es)" << std::endl;
+    std::cout << "Output generated in " << output_dir << std::endl;
+    PROFILE_REPORT();
+
+    return failed ? 1 : 0;
+}
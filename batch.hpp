@@ -0,0 +1,195 @@
+#ifndef BATCH_HPP_
+#define BATCH_HPP_
+
+#include<atomic>
+#include<chrono>
+#include<exception>
+#include<filesystem>
+#include<thread>
+
+#include "sim_options.hpp"
+
+//One simulation of a batch: its input files, options and the name its logs are written under
+struct scenario_t {
+    std::string                 name;           //!< logs go to <output dir>/<name>_execution.txt and <name>_system_status.txt (or <name>_execution.simlog)
+    std::string                 trace;
+    std::string                 vector_table;
+    std::string                 device_table;
+    std::string                 external_files;
+    std::string                 program_prefix; //!< where EXEC finds programs (see compile_trace)
+    std::vector<std::string>    arguments;      //!< the command line options, as given
+    sim_options_t               options;        //!< the same, parsed
+    std::string                 error;          //!< why the manifest line cannot run (empty if it can)
+};
+
+struct scenario_result_t {
+    bool        ok = false;
+    int         end_time = 0;       //!< simulated time at the end
+    double      seconds = 0.0;      //!< wall time of the run
+    std::string error;
+};
+
+//Strips leading and trailing white space
+std::string_view trim(std::string_view text) {
+    size_t first = text.find_first_not_of(" \t\r");
+    if(first == std::string_view::npos) {
+        return {};
+    }
+    size_t last = text.find_last_not_of(" \t\r");
+    return text.substr(first, last - first + 1);
+}
+
+//Parses a scenario's options the way main does. Throws std::runtime_error if one is not valid.
+sim_options_t parse_scenario_options(const std::vector<std::string>& arguments) {
+    return read_options(std::vector<std::string_view>(arguments.begin(), arguments.end()));
+}
+
+/**
+ * \brief read a batch manifest
+ *
+ * One scenario per line, fields separated by ',':
+ *   name, trace, vector table, device table, external files, program prefix[, options]
+ * where the options are given as on the command line, separated by spaces. Paths
+ * are relative to the working directory. Blank lines and lines starting with '#'
+ * are skipped. A line with an error (a missing field, an input file that cannot be
+ * opened, an unknown option) becomes a scenario that fails with that error, and
+ * the other scenarios still run.
+ *
+ * @param filename path to the manifest
+ * @return the scenarios, in order
+ *
+ */
+std::vector<scenario_t> load_manifest(const std::string& filename) {
+    std::ifstream input_file(filename);
+    if(!input_file.is_open()) {
+        std::cerr << "Error: Unable to open file: " << filename << std::endl;
+        exit(1);
+    }
+
+    std::vector<scenario_t> scenarios;
+    std::string line;
+    int line_number = 0;
+    while(std::getline(input_file, line)) {
+        line_number++;
+        std::string_view content = trim(line);
+        if(content.empty() || content[0] == '#') {
+            continue;
+        }
+
+        auto fields = split_delim(content, ",");
+        scenario_t scenario;
+        scenario.name           = trim(fields[0]);
+        std::string where = filename + ":" + std::to_string(line_number) + ": ";
+        if(fields.size() < 6) {
+            scenario.error = where + "expected at least 6 fields, got " + std::to_string(fields.size());
+            scenarios.push_back(std::move(scenario));
+            continue;
+        }
+
+        scenario.trace          = trim(fields[1]);
+        scenario.vector_table   = trim(fields[2]);
+        scenario.device_table   = trim(fields[3]);
+        scenario.external_files = trim(fields[4]);
+        scenario.program_prefix = trim(fields[5]);
+        for(size_t i = 6; i < fields.size(); i++) {
+            for(const auto& argument : split_delim(trim(fields[i]), " ")) {
+                if(!argument.empty()) {
+                    scenario.arguments.push_back(argument);
+                }
+            }
+        }
+
+        for(const std::string* input : {&scenario.trace, &scenario.vector_table, &scenario.device_table, &scenario.external_files}) {
+            if(scenario.error.empty() && !std::ifstream(*input).is_open()) {
+                scenario.error = where + "unable to open file: " + *input;
+            }
+        }
+        if(scenario.error.empty()) {
+            try {
+                scenario.options = parse_scenario_options(scenario.arguments);
+            } catch(const std::runtime_error& error) {
+                scenario.error = where + error.what();
+            }
+        }
+
+        scenarios.push_back(std::move(scenario));
+    }
+
+    return scenarios;
+}
+
+//Runs one scenario on the calling thread and writes its logs to output_dir
+scenario_result_t run_scenario(const scenario_t& scenario, const std::string& output_dir, program_cache_t& cache) {
+    scenario_result_t result;
+    if(!scenario.error.empty()) {
+        result.error = scenario.error;
+        return result;
+    }
+    auto start = std::chrono::steady_clock::now();
+
+    //errors are thrown (never exit()), so that they fail only this scenario
+    try {
+        auto [vectors, delays, external_files] = load_tables(scenario.trace, scenario.vector_table, scenario.device_table, scenario.external_files);
+
+        simulation_context_t context{make_vector_table(vectors), std::move(delays), std::move(external_files), {}};
+        context.catalog = make_program_catalog(context.external_files);
+
+        compiled_trace_t compiled = load_trace(scenario.trace, scenario.program_prefix, &cache);
+        check_table_numbers(compiled, context);
+
+        run_logs_t logs;
+        if(!logs.open(scenario.options.log_format, scenario.options.status_format, output_dir + "/" + scenario.name + "_", context.vectors)) {
+            result.error = "cannot write to " + output_dir;
+        } else {
+            machine_t machine(scenario.options.allocation_policy, scenario.options.partition_sizes);
+            scheduler_metrics_t metrics;
+            result.end_time = run_simulation(machine, compiled, context, scenario.options, *logs.log, metrics);
+            logs.close();
+            result.ok = true;
+        }
+    } catch(const std::exception& error) {
+        result.error = error.what();
+    }
+
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+/**
+ * \brief run every scenario of a batch on a pool of threads
+ *
+ * Each thread takes the next scenario not yet started until there are none left.
+ * Scenarios share nothing but the read-only list and the program cache: each run
+ * gets its own machine (memory and PID counter) and compiled trace, and writes its
+ * own log files. A program file used by several scenarios is compiled only once.
+ *
+ * @param scenarios the scenarios to run
+ * @param output_dir where the logs are written (must exist)
+ * @param threads how many threads run scenarios (the calling thread is one of them)
+ * @param cache the compiled programs, shared by every scenario
+ * @return the result of each scenario, in the same order
+ *
+ */
+std::vector<scenario_result_t> run_batch(const std::vector<scenario_t>& scenarios, const std::string& output_dir, unsigned int threads, program_cache_t& cache) {
+    std::vector<scenario_result_t> results(scenarios.size());
+    std::atomic<size_t> next_scenario{0};
+
+    auto worker = [&]() {
+        for(size_t i = next_scenario++; i < scenarios.size(); i = next_scenario++) {
+            results[i] = run_scenario(scenarios[i], output_dir, cache);
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for(unsigned int t = 1; t < threads; t++) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for(auto& thread : pool) {
+        thread.join();
+    }
+
+    return results;
+}
+
+#endif
@@ -0,0 +1,146 @@
+/**
+ *
+ * @file bench_allocator.cpp
+ * Runs the same random allocate/free workload through every allocation policy
+ * (and the linear scan allocate_memory used to do) over layouts of thousands of
+ * partitions, and reports latency, failed allocations and fragmentation.
+ *
+ */
+
+#include "memory_allocator.hpp"
+
+#include<random>
+
+//The linear scan allocate_memory used to do: the highest numbered free partition that fits
+struct linear_scan_t {
+    std::vector<unsigned int>   sizes;
+    std::vector<bool>           used;
+
+    int allocate(unsigned int size) {
+        for(size_t i = sizes.size(); i-- > 0;) {
+            if(sizes[i] >= size && !used[i]) {
+                used[i] = true;
+                return static_cast<int>(i + 1);
+            }
+        }
+        return -1;
+    }
+
+    void release(int partition_number) {
+        used[partition_number - 1] = false;
+    }
+};
+
+//Partition sizes between 1 and 64 Mb, in random order
+std::vector<unsigned int> make_layout(size_t partitions, std::mt19937& random) {
+    std::uniform_int_distribution<unsigned int> size(1, 64);
+    std::vector<unsigned int> sizes(partitions);
+    for(auto& s : sizes) {
+        s = size(random);
+    }
+    return sizes;
+}
+
+//Keeps memory about half full: allocates while below that, frees at random otherwise
+template<typename A>
+void run_workload(A& allocator, size_t operations, uint64_t total) {
+    std::mt19937 random(42);
+    std::uniform_int_distribution<unsigned int> size(1, 40);
+    std::vector<std::pair<int, unsigned int>> live;
+    uint64_t in_use = 0;
+
+    for(size_t op = 0; op < operations; op++) {
+        if(live.empty() || in_use < total / 2) {
+            unsigned int request = size(random);
+            int partition = allocator.allocate(request, static_cast<int>(op));
+            if(partition >= 0) {
+                live.push_back({partition, request});
+                in_use += request;
+            } else if(!live.empty()) {
+                size_t victim = random() % live.size();
+                in_use -= live[victim].second;
+                allocator.release(live[victim].first);
+                live[victim] = live.back();
+                live.pop_back();
+            }
+        } else {
+            size_t victim = random() % live.size();
+            in_use -= live[victim].second;
+            allocator.release(live[victim].first);
+            live[victim] = live.back();
+            live.pop_back();
+        }
+    }
+}
+
+//Adapts linear_scan_t to the allocator calls run_workload makes, and times them
+struct timed_scan_t {
+    linear_scan_t   scan;
+    uint64_t        calls = 0;
+    uint64_t        failures = 0;
+    uint64_t        total_ns = 0;
+
+    int allocate(unsigned int size, int) {
+        auto start = std::chrono::steady_clock::now();
+        int partition = scan.allocate(size);
+        total_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        calls++;
+        failures += partition < 0;
+        return partition;
+    }
+
+    void release(int partition_number) {
+        auto start = std::chrono::steady_clock::now();
+        scan.release(partition_number);
+        total_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        calls++;
+    }
+};
+
+int main() {
+    const size_t operations = 200000;
+
+    std::cout << std::setw(12) << "partitions"
+              << std::setw(14) << "policy"
+              << std::setw(12) << "avg ns"
+              << std::setw(10) << "failed"
+              << std::setw(12) << "internal"
+              << std::setw(12) << "external" << std::endl;
+
+    for(size_t partitions : {1000, 4000, 16000}) {
+        std::mt19937 random(7);
+        std::vector<unsigned int> sizes = make_layout(partitions, random);
+        uint64_t total = 0;
+        for(unsigned int size : sizes) {
+            total += size;
+        }
+
+        timed_scan_t scan{{sizes, std::vector<bool>(sizes.size(), false)}};
+        run_workload(scan, operations, total);
+        std::cout << std::setw(12) << partitions
+                  << std::setw(14) << "linear scan"
+                  << std::setw(12) << scan.total_ns / scan.calls
+                  << std::setw(10) << scan.failures << std::endl;
+
+        for(allocation_policy_t policy : {allocation_policy_t::FIRST_FIT, allocation_policy_t::BEST_FIT,
+                                          allocation_policy_t::WORST_FIT, allocation_policy_t::BUDDY}) {
+            auto allocator = make_memory_allocator(policy, sizes);
+            run_workload(*allocator, operations, total);
+
+            const allocator_stats_t& stats = allocator->stats;
+            uint64_t calls = stats.allocations + stats.failures + stats.releases;
+            double internal = stats.granted ? 100.0 * (stats.granted - stats.requested) / stats.granted : 0.0;
+            double external = allocator->free_size() ? 100.0 * (allocator->free_size() - allocator->largest_free()) / allocator->free_size() : 0.0;
+
+            std::cout << std::setw(12) << partitions
+                      << std::setw(14) << allocation_policy_name(policy)
+                      << std::setw(12) << stats.total_latency_ns / calls
+                      << std::setw(10) << stats.failures
+                      << std::fixed << std::setprecision(1)
+                      << std::setw(11) << internal << "%"
+                      << std::setw(11) << external << "%" << std::defaultfloat << std::endl;
+        }
+        std::cout << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,88 @@
+/**
+ *
+ * @file bench_batch.cpp
+ * Writes a synthetic regression suite to a temporary directory and runs it through
+ * run_batch with 1, 2, 4, ... threads (up to the number of cores), reporting
+ * scenarios per second and the speedup over one thread.
+ *
+ */
+
+#include "batch.hpp"
+#include "bench_common.hpp"
+
+#include<random>
+
+namespace fs = std::filesystem;
+
+//'count' scenarios, each a long trace of CPU bursts, system calls and FORK/EXECs
+std::vector<scenario_t> make_suite(const fs::path& dir, int count) {
+    std::mt19937 random(5);
+    write_bench_tables(dir, bench_delays());
+
+    std::vector<scenario_t> scenarios;
+    for(int s = 0; s < count; s++) {
+        std::string name = "scenario" + std::to_string(s);
+        std::string trace, program;
+        for(int group = 0; group < 20000; group++) {
+            trace += "CPU, " + std::to_string(random() % 100) + "\nSYSCALL, " + std::to_string(random() % 20) + "\n";
+            program += "CPU, " + std::to_string(random() % 100) + "\nEND_IO, " + std::to_string(random() % 20) + "\n";
+        }
+        trace += "FORK, 10\nIF_CHILD, 0\nEXEC program1, 20\nIF_PARENT, 0\nCPU, 5\nENDIF, 0\n";
+
+        write_file(dir / (name + "_trace.txt"), trace);
+        write_file(dir / (name + "_program1.txt"), program);
+        write_file(dir / (name + "_external_files.txt"), "program1, 10\n");
+
+        scenario_t scenario;
+        scenario.name = name;
+        scenario.trace = (dir / (name + "_trace.txt")).string();
+        scenario.vector_table = (dir / "vector_table.txt").string();
+        scenario.device_table = (dir / "device_table.txt").string();
+        scenario.external_files = (dir / (name + "_external_files.txt")).string();
+        scenario.program_prefix = (dir / (name + "_")).string();
+        scenarios.push_back(std::move(scenario));
+    }
+    return scenarios;
+}
+
+int main() {
+    fs::path dir = fs::temp_directory_path() / "bench_batch";
+    fs::remove_all(dir);
+    fs::create_directories(dir / "out");
+
+    const int count = 32;
+    std::vector<scenario_t> scenarios = make_suite(dir, count);
+    unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+
+    std::cout << count << " scenarios, " << cores << " core(s)" << std::endl;
+    std::cout << std::setw(10) << "threads"
+              << std::setw(14) << "seconds"
+              << std::setw(16) << "scenarios/s"
+              << std::setw(12) << "speedup" << std::endl;
+
+    double single = 0.0;
+    for(unsigned int threads = 1; threads <= cores; threads *= 2) {
+        auto start = std::chrono::steady_clock::now();
+        program_cache_t cache;
+        std::vector<scenario_result_t> results = run_batch(scenarios, (dir / "out").string(), threads, cache);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        for(const auto& result : results) {
+            if(!result.ok) {
+                std::cout << "FAIL: " << result.error << std::endl;
+                return 1;
+            }
+        }
+        if(threads == 1) {
+            single = seconds;
+        }
+
+        std::cout << std::setw(10) << threads
+                  << std::setw(14) << std::fixed << std::setprecision(3) << seconds
+                  << std::setw(16) << std::setprecision(1) << count / seconds
+                  << std::setw(12) << std::setprecision(2) << single / seconds << std::endl;
+    }
+
+    fs::remove_all(dir);
+    return 0;
+}
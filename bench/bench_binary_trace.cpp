@@ -0,0 +1,148 @@
+/**
+ *
+ * @file bench_binary_trace.cpp
+ * Loads a large trace as text (compile_trace) and as a binary trace (mapped by
+ * load_binary_trace), and reports the time and the heap bytes each way takes.
+ * Both ways must give the same instructions and branch tables.
+ *
+ */
+
+#include "binary_trace.hpp"
+#include "bench_common.hpp"
+
+#include<chrono>
+#include<cstdlib>
+#include<filesystem>
+#include<iomanip>
+#include<new>
+#include<random>
+
+namespace fs = std::filesystem;
+
+static size_t allocated_bytes = 0;
+
+//Counts the bytes allocated (not inlined, so that new and delete stay a matched pair)
+[[gnu::noinline]] void* operator new(std::size_t size) {
+    allocated_bytes += size;
+    if(void* block = std::malloc(size ? size : 1)) {
+        return block;
+    }
+    throw std::bad_alloc();
+}
+
+[[gnu::noinline]] void operator delete(void* block) noexcept {
+    std::free(block);
+}
+
+[[gnu::noinline]] void operator delete(void* block, std::size_t) noexcept {
+    std::free(block);
+}
+
+bool same_instruction(const instruction_t& a, const instruction_t& b) {
+    return a.op == b.op && a.operand == b.operand && a.program == b.program;
+}
+
+//True if both traces have the same programs, code, views and branch tables
+bool same_trace(const compiled_trace_t& a, const compiled_trace_t& b) {
+    if(a.programs.size() != b.programs.size() || a.views.size() != b.views.size()) {
+        return false;
+    }
+    for(size_t id = 0; id < a.programs.size(); id++) {
+        code_span_t x = a.programs[id].code();
+        code_span_t y = b.programs[id].code();
+        if(a.programs[id].program_name != b.programs[id].program_name || a.programs[id].exec_targets != b.programs[id].exec_targets
+           || x.size() != y.size() || !std::equal(x.begin(), x.end(), y.begin(), same_instruction)) {
+            return false;
+        }
+    }
+    for(size_t id = 0; id < a.views.size(); id++) {
+        const trace_view_t& x = a.views[id];
+        const trace_view_t& y = b.views[id];
+        if(x.program != y.program || x.resolved != y.resolved || x.ranges.size() != y.ranges.size() || x.forks.size() != y.forks.size()) {
+            return false;
+        }
+        for(size_t r = 0; r < x.ranges.size(); r++) {
+            if(x.ranges[r].begin != y.ranges[r].begin || x.ranges[r].end != y.ranges[r].end) {
+                return false;
+            }
+        }
+        for(const auto& [index, fork] : x.forks) {
+            auto found = y.forks.find(index);
+            if(found == y.forks.end() || found->second.child_view != fork.child_view || found->second.endif != fork.endif
+               || found->second.parent_resume.range != fork.parent_resume.range || found->second.parent_resume.index != fork.parent_resume.index) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int main() {
+    fs::path dir = fs::temp_directory_path() / "bench_binary_trace";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    std::string prefix = (dir / "").string();
+
+    //a trace of 1000 FORK blocks (the child EXECs one of 4 programs of 250000 lines) of 500 lines each
+    std::mt19937 random(5);
+    const int programs = 4;
+    std::string trace;
+    for(int block = 0; block < 1000; block++) {
+        trace += "FORK, 10\nIF_CHILD, 0\nEXEC program" + std::to_string(block % programs) + ", 20\nIF_PARENT, 0\nCPU, 5\nENDIF, 0\n";
+        for(int line = 0; line < 247; line++) {
+            trace += "CPU, " + std::to_string(random() % 100) + "\nSYSCALL, " + std::to_string(random() % 20) + "\n";
+        }
+    }
+    write_file(dir / "trace.txt", trace);
+    for(int p = 0; p < programs; p++) {
+        std::string program;
+        for(int line = 0; line < 125000; line++) {
+            program += "CPU, " + std::to_string(random() % 100) + "\nEND_IO, " + std::to_string(random() % 20) + "\n";
+        }
+        write_file(dir / ("program" + std::to_string(p) + ".txt"), program);
+    }
+
+    std::string trace_file = (dir / "trace.txt").string();
+    std::string binary_file = (dir / "trace.bin").string();
+    if(!write_binary_trace(compile_trace(trace_file, prefix), binary_file)) {
+        std::cout << "FAIL: cannot write " << binary_file << std::endl;
+        return 1;
+    }
+
+    const int runs = 10;
+    //load the trace 'runs' times and keep the last one; returns the ms and heap bytes per load
+    auto load_all = [&](auto load, compiled_trace_t& compiled, double& ms, size_t& bytes) {
+        size_t before = allocated_bytes;
+        auto start = std::chrono::steady_clock::now();
+        for(int run = 0; run < runs; run++) {
+            compiled = compiled_trace_t();
+            compiled = load();
+        }
+        ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / runs;
+        bytes = (allocated_bytes - before) / runs;
+    };
+
+    compiled_trace_t text;
+    compiled_trace_t binary;
+    double text_ms = 0.0, binary_ms = 0.0;
+    size_t text_bytes = 0, binary_bytes = 0;
+    load_all([&] { return compile_trace(trace_file, prefix); }, text, text_ms, text_bytes);
+    load_all([&] { return load_binary_trace(binary_file); }, binary, binary_ms, binary_bytes);
+
+    std::cout << "Trace of " << text.programs[ROOT_PROGRAM].code().size() << " lines, " << programs << " programs, "
+              << text.views.size() << " views; text " << fs::file_size(trace_file) / 1024 << " KiB + programs, binary "
+              << fs::file_size(binary_file) / 1024 << " KiB" << std::endl;
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "  text (compile_trace):        " << std::setw(8) << text_ms << " ms  " << std::setw(10) << text_bytes / 1024 << " KiB allocated" << std::endl;
+    std::cout << "  binary (load_binary_trace):  " << std::setw(8) << binary_ms << " ms  " << std::setw(10) << binary_bytes / 1024 << " KiB allocated" << std::endl;
+
+    bool same = same_trace(text, binary);
+    text = compiled_trace_t();
+    binary = compiled_trace_t();
+    fs::remove_all(dir);
+    if(!same) {
+        std::cout << "FAIL: the binary trace differs from the text trace" << std::endl;
+        return 1;
+    }
+    return 0;
+}
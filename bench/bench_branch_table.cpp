@@ -0,0 +1,129 @@
+/**
+ *
+ * @file bench_branch_table.cpp
+ * Compares resolving FORKs through the branch table against the forward scan
+ * (and child trace copy) simulate_trace used to do on every FORK.
+ *
+ */
+
+#include "compiled_trace.hpp"
+
+#include<chrono>
+#include<iomanip>
+#include<sstream>
+
+//The scan simulate_trace used to run from each FORK: collects the child trace and
+//returns the index the parent resumes after
+size_t legacy_resolve(const std::vector<instruction_t>& trace_file, size_t i, std::vector<instruction_t>& child_trace) {
+    bool skip = true;
+    bool exec_flag = false;
+    size_t parent_index = 0;
+
+    for(size_t j = i; j < trace_file.size(); j++) {
+        auto activity = trace_file[j].op;
+        if(skip && activity == opcode_t::IF_CHILD) {
+            skip = false;
+            continue;
+        } else if(activity == opcode_t::IF_PARENT) {
+            skip = true;
+            parent_index = j;
+            if(exec_flag) {
+                break;
+            }
+        } else if(skip && activity == opcode_t::ENDIF) {
+            skip = false;
+            continue;
+        } else if(!skip && activity == opcode_t::EXEC) {
+            skip = true;
+            child_trace.push_back(trace_file[j]);
+            exec_flag = true;
+        }
+
+        if(!skip) {
+            child_trace.push_back(trace_file[j]);
+        }
+    }
+
+    return parent_index;
+}
+
+//'depth' FORKs nested inside each other's IF_CHILD branch
+std::string nested_trace(int depth) {
+    std::string trace;
+    for(int d = 0; d < depth; d++) {
+        trace += "FORK, 10\nIF_CHILD, 0\n";
+    }
+    trace += "CPU, 50\n";
+    for(int d = 0; d < depth; d++) {
+        trace += "IF_PARENT, 0\nCPU, 20\nENDIF, 0\n";
+    }
+    return trace;
+}
+
+//'width' FORKs one after the other, each child EXECing a program
+std::string wide_trace(int width) {
+    std::string trace;
+    for(int w = 0; w < width; w++) {
+        trace += "FORK, 10\nIF_CHILD, 0\nEXEC program1, 20\nIF_PARENT, 0\nCPU, 30\nENDIF, 0\n";
+    }
+    return trace;
+}
+
+double elapsed_ms(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void run_shape(const char* shape, std::string (*generate)(int), const std::vector<int>& sizes) {
+    std::cout << shape << std::endl;
+    std::cout << std::setw(8) << "forks"
+              << std::setw(16) << "legacy scan ms"
+              << std::setw(16) << "table build ms"
+              << std::setw(16) << "lookup ms"
+              << std::setw(10) << "views" << std::endl;
+
+    for(int size : sizes) {
+        std::istringstream input(generate(size));
+        compiled_trace_t compiled;
+        compiled.programs.emplace_back("init");
+        compile_stream(input, ROOT_PROGRAM, compiled);
+        const std::vector<instruction_t> code(compiled.programs[ROOT_PROGRAM].code().begin(), compiled.programs[ROOT_PROGRAM].code().end());
+
+        //resolve every FORK of the trace, the old way
+        auto start = std::chrono::steady_clock::now();
+        size_t checksum = 0;
+        for(size_t i = 0; i < code.size(); i++) {
+            if(code[i].op == opcode_t::FORK) {
+                std::vector<instruction_t> child_trace;
+                checksum += legacy_resolve(code, i, child_trace) + child_trace.size();
+            }
+        }
+        double legacy = elapsed_ms(start);
+
+        start = std::chrono::steady_clock::now();
+        build_branch_tables(compiled);
+        double build = elapsed_ms(start);
+
+        start = std::chrono::steady_clock::now();
+        const trace_view_t& view = compiled.views[ROOT_PROGRAM];
+        for(uint32_t i = 0; i < code.size(); i++) {
+            if(code[i].op == opcode_t::FORK) {
+                checksum += view.forks.at(i).parent_resume.index;
+            }
+        }
+        double lookup = elapsed_ms(start);
+
+        std::cout << std::setw(8) << size
+                  << std::setw(16) << std::fixed << std::setprecision(3) << legacy
+                  << std::setw(16) << build
+                  << std::setw(16) << lookup
+                  << std::setw(10) << compiled.views.size()
+                  << "   (" << checksum << ")" << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+int main() {
+    run_shape("deep nesting", nested_trace, {1000, 2000, 4000, 8000, 16000});
+    run_shape("wide forks", wide_trace, {1000, 2000, 4000, 8000, 16000});
+    return 0;
+}
@@ -0,0 +1,94 @@
+#ifndef BENCH_COMMON_HPP_
+#define BENCH_COMMON_HPP_
+
+#include<filesystem>
+#include<fstream>
+#include<functional>
+#include<sstream>
+#include<string>
+#include<vector>
+
+#include "interrupts_101259994_101108918.hpp"
+#include "compiled_trace.hpp"
+
+//The fixtures the benchmarks share: the vector and device tables, a simulation
+//context built from them, and the synthetic fork/exec workloads they run.
+
+//The ISR addresses of the benchmarks' vector table (26 vectors, as in vector_table.txt)
+std::vector<std::string> bench_vectors() {
+    std::vector<std::string> vectors;
+    for(int i = 0; i < 26; i++) {
+        char address[10];
+        sprintf(address, "0X%04X", 0x100 + 37 * i);
+        vectors.push_back(address);
+    }
+    return vectors;
+}
+
+//A device table whose devices take 40, 60, 80, ... ms
+std::vector<int> bench_delays(int devices = 20) {
+    std::vector<int> delays;
+    for(int device = 0; device < devices; device++) {
+        delays.push_back(40 + 20 * device);
+    }
+    return delays;
+}
+
+//The benchmarks' vector table with the given device and external files tables
+simulation_context_t bench_context(const std::vector<int>& delays, const std::vector<external_file>& external_files = {}) {
+    return {make_vector_table(bench_vectors()), delays, external_files, make_program_catalog(external_files)};
+}
+
+void write_file(const std::filesystem::path& path, const std::string& contents) {
+    std::ofstream file(path, std::ios::binary);
+    file << contents;
+}
+
+//Writes the benchmarks' vector table and the given device table to 'dir', as the simulator reads them
+void write_bench_tables(const std::filesystem::path& dir, const std::vector<int>& delays) {
+    std::string vectors, devices;
+    for(const std::string& address : bench_vectors()) {
+        vectors += address + "\n";
+    }
+    for(int delay : delays) {
+        devices += std::to_string(delay) + "\n";
+    }
+    write_file(dir / "vector_table.txt", vectors);
+    write_file(dir / "device_table.txt", devices);
+}
+
+//init forks 'children' processes, one after the other: each child EXECs the program
+//'program' names, while the parent runs a short CPU burst
+std::string fork_exec_trace(int children, const std::function<std::string()>& program) {
+    std::string trace;
+    for(int child = 0; child < children; child++) {
+        trace += "FORK, 10\nIF_CHILD, 0\nEXEC " + program() + ", 20\nIF_PARENT, 0\nCPU, 5\nENDIF, 0\n";
+    }
+    return trace;
+}
+
+//Compiles 'trace' as init's program, then every program it EXECs from the code
+//'program' gives for its name, and resolves the branch tables
+compiled_trace_t compile_workload(const std::string& trace, const std::function<std::string(const std::string&)>& program = {}) {
+    compiled_trace_t compiled;
+    compiled.programs.emplace_back("init");
+    std::istringstream input(trace);
+    compile_stream(input, ROOT_PROGRAM, compiled);
+    for(uint32_t id = ROOT_PROGRAM + 1; id < compiled.programs.size(); id++) {
+        std::istringstream code(program(compiled.programs[id].program_name));
+        compile_stream(code, id, compiled);
+    }
+    build_branch_tables(compiled);
+    return compiled;
+}
+
+//One FORK whose child and parent both run 'groups' CPU/SYSCALL/END_IO groups
+compiled_trace_t compile_long_trace(int groups) {
+    std::string trace = "FORK, 10\nIF_CHILD, 0\nCPU, 5\nIF_PARENT, 0\nCPU, 7\nENDIF, 0\n";
+    for(int g = 0; g < groups; g++) {
+        trace += "CPU, 40\nSYSCALL, 4\nCPU, 15\nEND_IO, 6\n";
+    }
+    return compile_workload(trace);
+}
+
+#endif
@@ -0,0 +1,143 @@
+/**
+ *
+ * @file bench_copy_count.cpp
+ * Counts what each simulated event copies (heap allocations and bytes allocated)
+ * through the old by-value signatures and through the current ones.
+ *
+ */
+
+#include "simulator.hpp"
+#include "bench_common.hpp"
+
+#include<cstdlib>
+#include<new>
+
+static size_t allocations = 0;
+static size_t allocated_bytes = 0;
+
+//Counts every allocation and its bytes (not inlined, so that new and delete stay a matched pair)
+[[gnu::noinline]] void* operator new(std::size_t size) {
+    allocations++;
+    allocated_bytes += size;
+    if(void* block = std::malloc(size ? size : 1)) {
+        return block;
+    }
+    throw std::bad_alloc();
+}
+
+[[gnu::noinline]] void operator delete(void* block) noexcept {
+    std::free(block);
+}
+
+[[gnu::noinline]] void operator delete(void* block, std::size_t) noexcept {
+    std::free(block);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// The old signatures, as they were before the tables moved into simulation_context_t
+
+std::pair<std::string, int> old_intr_boilerplate(int current_time, int intr_num, int context_save_time, std::vector<std::string> vectors) {
+    std::string execution = "";
+
+    execution += std::to_string(current_time) + ", " + std::to_string(1) + ", switch to kernel mode\n";
+    current_time++;
+
+    execution += std::to_string(current_time) + ", " + std::to_string(context_save_time) + ", context saved\n";
+    current_time += context_save_time;
+
+    char vector_address_c[10];
+    sprintf(vector_address_c, "0x%04X", (ADDR_BASE + (intr_num * VECTOR_SIZE)));
+    std::string vector_address(vector_address_c);
+
+    execution += std::to_string(current_time) + ", " + std::to_string(1) + ", find vector " + std::to_string(intr_num)
+                    + " in memory position " + vector_address + "\n";
+    current_time++;
+
+    execution += std::to_string(current_time) + ", " + std::to_string(1) + ", load address " + vectors.at(intr_num) + " into the PC\n";
+    current_time++;
+
+    return std::make_pair(execution, current_time);
+}
+
+unsigned int old_get_size(std::string name, std::vector<external_file> external_files) {
+    int size = -1;
+
+    for (auto file : external_files) {
+        if(file.program_name == name){
+            size = file.size;
+            break;
+        }
+    }
+
+    return size;
+}
+
+//What every recursive simulate_trace call (one per FORK and EXEC) paid for its parameters
+size_t old_simulate_trace_call(std::vector<std::string> trace_file, std::vector<std::string> vectors, std::vector<int> delays, std::vector<external_file> external_files, PCB current, std::vector<PCB> wait_queue) {
+    return trace_file.size() + vectors.size() + delays.size() + external_files.size() + current.size + wait_queue.size();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+//The same tables passed the current way
+size_t new_simulate_trace_call(const compiled_trace_t& compiled, const simulation_context_t& context, const PCB& current) {
+    return compiled.programs.size() + context.vectors.addresses.size() + context.delays.size() + context.external_files.size() + current.size;
+}
+
+struct counts_t {
+    size_t allocations;
+    size_t bytes;
+};
+
+template<typename F>
+counts_t count(F&& event) {
+    size_t before = allocations;
+    size_t before_bytes = allocated_bytes;
+    event();
+    return {allocations - before, allocated_bytes - before_bytes};
+}
+
+void report(const char* event, counts_t before, counts_t after) {
+    std::cout << std::left << std::setw(26) << event << std::right
+              << std::setw(12) << before.allocations
+              << std::setw(14) << before.bytes
+              << std::setw(12) << after.allocations
+              << std::setw(14) << after.bytes << std::endl;
+}
+
+int main() {
+    std::vector<std::string> vectors = bench_vectors();
+    std::vector<external_file> external_files;
+    for(int i = 0; i < 1000; i++) {
+        external_files.push_back({"external_program" + std::to_string(i), static_cast<unsigned int>(i % 40 + 1)});
+    }
+    simulation_context_t context = bench_context(std::vector<int>(20, 100), external_files);
+
+    std::vector<std::string> trace_file(64, "SYSCALL, 4");
+    PCB current(1, 0, "external_program500", 10, 4);
+    compiled_trace_t compiled;
+    null_sink_t execution;
+    text_event_log_t log(execution, execution, context.vectors);
+    volatile size_t sink = 0;
+
+    std::cout << "per event, old signatures vs. current ones (" << external_files.size() << " external files)" << std::endl;
+    std::cout << std::left << std::setw(26) << "event" << std::right
+              << std::setw(12) << "old allocs"
+              << std::setw(14) << "old bytes"
+              << std::setw(12) << "new allocs"
+              << std::setw(14) << "new bytes" << std::endl;
+
+    report("interrupt boilerplate",
+           count([&] { sink = sink + old_intr_boilerplate(100, 4, 10, vectors).second; }),
+           count([&] { sink = sink + intr_boilerplate(log, 100, 4, 10, current); }));
+
+    report("program size lookup",
+           count([&] { sink = sink + old_get_size(current.program_name, external_files); }),
+           count([&] { unsigned int size = 0; find_program(context.catalog, current.program_name, size); sink = sink + size; }));
+
+    report("FORK/EXEC call parameters",
+           count([&] { sink = sink + old_simulate_trace_call(trace_file, vectors, context.delays, external_files, current, {}); }),
+           count([&] { sink = sink + new_simulate_trace_call(compiled, context, current); }));
+
+    return 0;
+}
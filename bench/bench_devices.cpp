@@ -0,0 +1,136 @@
+/**
+ *
+ * @file bench_devices.cpp
+ * Loads the device model with millions of pending requests and measures how fast
+ * they are made and completed, checking that every device serves its requests
+ * one at a time and in order. Then runs an I/O-heavy workload of thousands of
+ * processes under the scheduler with ideal and with queued I/O, to compare what
+ * device contention does to the makespan, the CPU utilization and the waits.
+ *
+ */
+
+#include "scheduler.hpp"
+#include "bench_common.hpp"
+
+#include<chrono>
+#include<random>
+
+double elapsed_ns(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+//Takes completions off the bank until 'left' are pending, checking them. Returns false if one is wrong.
+bool drain(device_bank_t& bank, size_t left, std::vector<int>& last_done, std::vector<uint32_t>& last_request, int& last_time) {
+    while(bank.requests > left) {
+        int time = bank.next_completion();
+        uint32_t device;
+        io_request_t request = bank.complete(device);
+        //in time order, each device's in the order they were made and at least its delay apart
+        bool in_order = time >= last_time && request.done == time
+                     && (last_request[device] == UINT32_MAX || request.process > last_request[device])
+                     && time >= last_done[device] + bank.devices[device].delay;
+        if(!in_order) {
+            return false;
+        }
+        last_time = time;
+        last_done[device] = time;
+        last_request[device] = request.process;
+    }
+    return true;
+}
+
+//init forks 'children' processes, each doing short CPU bursts between SYSCALLs on a few devices
+compiled_trace_t make_workload(int children) {
+    std::mt19937 random(21);
+    std::string trace = fork_exec_trace(children, [&] { return "worker" + std::to_string(random() % 4); });
+    return compile_workload(trace, [&](const std::string&) {
+        std::string program;
+        for(int step = 0; step < 6; step++) {
+            int device = 3 + random() % 2;
+            program += "CPU, " + std::to_string(1 + random() % 10) + "\nSYSCALL, " + std::to_string(device) + "\nCPU, 5\nEND_IO, " + std::to_string(device) + "\n";
+        }
+        return program;
+    });
+}
+
+int main() {
+    std::vector<int> delays = bench_delays();
+
+    //Millions of requests pending at once: all made first, then all completed
+    const uint32_t requests = 4000000;
+    std::mt19937 random(3);
+    bool ok = true;
+    {
+        device_bank_t bank(delays);
+        std::vector<int> last_done(delays.size(), INT32_MIN / 2);
+        std::vector<uint32_t> last_request(delays.size(), UINT32_MAX);
+        int last_time = 0;
+
+        auto start = std::chrono::steady_clock::now();
+        for(uint32_t request = 0; request < requests; request++) {
+            bank.submit(random() % delays.size(), request, request / 4);
+        }
+        double submit_ns = elapsed_ns(start);
+        size_t peak = bank.requests;
+
+        start = std::chrono::steady_clock::now();
+        ok = drain(bank, 0, last_done, last_request, last_time) && ok;
+        double complete_ns = elapsed_ns(start);
+
+        std::cout << std::fixed << std::setprecision(1);
+        std::cout << requests << " requests, " << peak << " pending at most: " << submit_ns / requests << " ns per request made, "
+                  << complete_ns / requests << " ns per completion" << std::endl;
+    }
+
+    //A steady state with a million requests pending: one made for each one completed
+    {
+        device_bank_t bank(delays);
+        std::vector<int> last_done(delays.size(), INT32_MIN / 2);
+        std::vector<uint32_t> last_request(delays.size(), UINT32_MAX);
+        int last_time = 0;
+        const uint32_t pending = 1000000;
+
+        uint32_t request = 0;
+        for(; request < pending; request++) {
+            bank.submit(random() % delays.size(), request, 0);
+        }
+        auto start = std::chrono::steady_clock::now();
+        for(; request < pending + requests && ok; request++) {
+            ok = drain(bank, pending - 1, last_done, last_request, last_time);
+            bank.submit(random() % delays.size(), request, last_time);
+        }
+        double steady_ns = elapsed_ns(start);
+        std::cout << requests << " completions with " << pending << " pending: " << steady_ns / requests
+                  << " ns per completion and new request" << std::endl << std::endl;
+        std::cout << std::defaultfloat;
+    }
+
+    if(!ok) {
+        std::cout << "FAIL: a device served its requests out of order or two at a time" << std::endl;
+        return 1;
+    }
+
+    //The same workload with every request served at once, and with the devices' queues
+    std::vector<external_file> external_files = {{"worker0", 4, 0}, {"worker1", 4, 0}, {"worker2", 4, 0}, {"worker3", 4, 0}};
+    simulation_context_t context = bench_context(delays, external_files);
+
+    const int children = 2000;
+    compiled_trace_t compiled = make_workload(children);
+    std::cout << children << " processes" << std::endl;
+    for(io_model_t io : {io_model_t::IDEAL, io_model_t::QUEUED}) {
+        machine_t machine(allocation_policy_t::BEST_FIT, std::vector<unsigned int>(children + 1, 4));
+        null_sink_t execution;
+        null_sink_t system_status;
+        text_event_log_t log(execution, system_status, context.vectors);
+        scheduler_config_t config{scheduling_policy_t::ROUND_ROBIN, DEFAULT_QUANTUM, io};
+        scheduler_metrics_t metrics;
+        auto start = std::chrono::steady_clock::now();
+        schedule_trace(compiled, ROOT_PROGRAM, 0, context, machine, PCB(0, -1, "init", 1, -1), config, log, metrics);
+        double seconds = elapsed_ns(start) / 1e9;
+
+        std::cout << (io == io_model_t::IDEAL ? "ideal I/O" : "queued I/O") << std::endl;
+        print_scheduler_metrics(std::cout, metrics);
+        std::cout << "  simulated in " << std::fixed << std::setprecision(3) << seconds << " s" << std::defaultfloat << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,122 @@
+/**
+ *
+ * @file bench_event_log.cpp
+ * Runs a long trace with the text logs and with the columnar log, then measures
+ * what an analysis pays to get the events back: parsing execution.txt line by line
+ * vs. reading the columns. Both give the total time per kind of event, which must
+ * match. Also checks that the columnar log renders back to the same text.
+ *
+ */
+
+#include "simulator.hpp"
+#include "bench_common.hpp"
+
+#include<chrono>
+
+double elapsed_ms(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+//Total duration per description, parsed from the text of execution.txt ("time, duration, description")
+std::map<std::string, int64_t> totals_from_text(std::string_view text) {
+    std::map<std::string, int64_t> totals;
+    while(!text.empty()) {
+        size_t end = text.find('\n');
+        std::string_view line = text.substr(0, end);
+        text.remove_prefix(end == std::string_view::npos ? text.size() : end + 1);
+
+        auto fields = split_delim(line, ", ");
+        if(fields.size() >= 3) {
+            totals[fields[2]] += std::stoi(fields[1]);
+        }
+    }
+    return totals;
+}
+
+//Total duration per kind of event, read from the columns of a columnar log
+std::vector<int64_t> totals_from_columns(std::string_view log) {
+    std::vector<int64_t> totals(static_cast<size_t>(event_kind_t::COUNT), 0);
+    size_t offset = sizeof(event_log_header_t);
+    while(offset + 8 <= log.size()) {
+        uint32_t tag, count;
+        std::memcpy(&tag, log.data() + offset, 4);
+        std::memcpy(&count, log.data() + offset + 4, 4);
+        offset += 8;
+        if(tag == EVENT_CHUNK_END) {
+            break;
+        } else if(tag == EVENT_CHUNK_EVENTS) {
+            //only two columns are read: duration and kind
+            const int32_t* durations = reinterpret_cast<const int32_t*>(log.data() + offset) + count;
+            const uint8_t* kinds = reinterpret_cast<const uint8_t*>(log.data() + offset + size_t(count) * EVENT_INT_COLUMNS * 4);
+            for(uint32_t i = 0; i < count; i++) {
+                totals[kinds[i]] += durations[i];
+            }
+            offset += size_t(count) * EVENT_INT_COLUMNS * 4 + ((count + 3) & ~3u);
+        } else if(tag == EVENT_CHUNK_STATUS) {
+            offset += size_t(count) * sizeof(status_record_t);
+        } else if(tag == EVENT_CHUNK_NAMES) {
+            for(uint32_t i = 0; i < count; i++) {
+                uint32_t length;
+                std::memcpy(&length, log.data() + offset, 4);
+                offset += 4 + ((length + 3) & ~3u);
+            }
+        }
+    }
+    return totals;
+}
+
+int main() {
+    simulation_context_t context = bench_context(std::vector<int>(20, 100));
+    compiled_trace_t compiled = compile_long_trace(200000);
+
+    memory_sink_t execution;
+    memory_sink_t system_status;
+    memory_sink_t columns;
+    double text_ms, columnar_ms;
+    {
+        machine_t machine;
+        text_event_log_t log(execution, system_status, context.vectors);
+        auto start = std::chrono::steady_clock::now();
+        simulate_trace(compiled, ROOT_PROGRAM, 0, context, machine, PCB(0, -1, "init", 1, 6), log);
+        execution.flush();
+        text_ms = elapsed_ms(start);
+    }
+    {
+        machine_t machine;
+        columnar_event_log_t log(columns);
+        auto start = std::chrono::steady_clock::now();
+        simulate_trace(compiled, ROOT_PROGRAM, 0, context, machine, PCB(0, -1, "init", 1, 6), log);
+        log.finish();
+        columnar_ms = elapsed_ms(start);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::map<std::string, int64_t> text_totals = totals_from_text(execution.str());
+    double parse_ms = elapsed_ms(start);
+    start = std::chrono::steady_clock::now();
+    std::vector<int64_t> column_totals = totals_from_columns(columns.str());
+    double read_ms = elapsed_ms(start);
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << std::setw(10) << "log" << std::setw(12) << "KiB" << std::setw(12) << "write ms" << std::setw(12) << "read ms" << std::endl;
+    std::cout << std::setw(10) << "text" << std::setw(12) << execution.str().size() / 1024.0 << std::setw(12) << text_ms << std::setw(12) << parse_ms << std::endl;
+    std::cout << std::setw(10) << "columnar" << std::setw(12) << columns.str().size() / 1024.0 << std::setw(12) << columnar_ms << std::setw(12) << read_ms << std::endl;
+
+    //the same totals both ways, and the same text once rendered
+    bool same = text_totals["CPU Burst"] == column_totals[static_cast<size_t>(event_kind_t::CPU_BURST)]
+             && text_totals["context saved"] == column_totals[static_cast<size_t>(event_kind_t::CONTEXT_SAVED)]
+             && text_totals["IRET"] == column_totals[static_cast<size_t>(event_kind_t::IRET)];
+
+    memory_sink_t rendered_execution;
+    memory_sink_t rendered_status;
+    text_event_log_t renderer(rendered_execution, rendered_status, context.vectors);
+    std::string error;
+    bool rendered = replay_event_log(columns.str(), renderer, error);
+    same = same && rendered && rendered_execution.str() == execution.str() && rendered_status.str() == system_status.str();
+
+    if(!same) {
+        std::cout << "FAIL: the columnar log does not match the text log " << error << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,104 @@
+/**
+ *
+ * @file bench_log_format.cpp
+ * Counts heap allocations per logged event and measures how many log lines per
+ * second the simulator produces. Exits with 1 if logging allocates per event.
+ *
+ */
+
+#include "simulator.hpp"
+#include "bench_common.hpp"
+
+#include<chrono>
+#include<cstdlib>
+#include<new>
+
+static size_t allocations = 0;
+
+//Counts every allocation (not inlined, so that new and delete stay a matched pair)
+[[gnu::noinline]] void* operator new(std::size_t size) {
+    allocations++;
+    if(void* block = std::malloc(size ? size : 1)) {
+        return block;
+    }
+    throw std::bad_alloc();
+}
+
+[[gnu::noinline]] void operator delete(void* block) noexcept {
+    std::free(block);
+}
+
+[[gnu::noinline]] void operator delete(void* block, std::size_t) noexcept {
+    std::free(block);
+}
+
+//Counts the lines written and throws them away
+struct line_count_sink_t : output_sink_t {
+    size_t lines = 0;
+
+    ~line_count_sink_t() override {
+        flush();
+    }
+
+protected:
+    void emit(const char* data, size_t size) override {
+        for(size_t i = 0; i < size; i++) {
+            lines += data[i] == '\n';
+        }
+    }
+};
+
+struct run_result_t {
+    size_t  allocations;
+    size_t  lines;
+    double  seconds;
+};
+
+run_result_t run(compiled_trace_t& compiled, const simulation_context_t& context) {
+    line_count_sink_t execution;
+    line_count_sink_t system_status;
+    machine_t machine;
+    PCB init(0, -1, "init", 1, 6);
+
+    size_t before = allocations;
+    auto start = std::chrono::steady_clock::now();
+    text_event_log_t log(execution, system_status, context.vectors);
+    simulate_trace(compiled, ROOT_PROGRAM, 0, context, machine, init, log);
+    execution.flush();
+    system_status.flush();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    return {allocations - before, execution.lines + system_status.lines, seconds};
+}
+
+int main() {
+    simulation_context_t context = bench_context(std::vector<int>(20, 100));
+
+    std::cout << std::setw(10) << "groups"
+              << std::setw(12) << "lines"
+              << std::setw(14) << "allocations"
+              << std::setw(16) << "lines/s" << std::endl;
+
+    std::vector<size_t> counts;
+    for(int groups : {10000, 100000, 1000000}) {
+        compiled_trace_t compiled = compile_long_trace(groups);
+        run(compiled, context);   //first run resolves the child's view
+        run_result_t result = run(compiled, context);
+        counts.push_back(result.allocations);
+
+        std::cout << std::setw(10) << groups
+                  << std::setw(12) << result.lines
+                  << std::setw(14) << result.allocations
+                  << std::setw(16) << std::fixed << std::setprecision(0) << result.lines / result.seconds << std::endl;
+    }
+
+    //the run itself allocates a few fixed things (the process stack), but nothing per event
+    for(size_t count : counts) {
+        if(count != counts.front()) {
+            std::cout << "FAIL: allocations grow with the number of events" << std::endl;
+            return 1;
+        }
+    }
+    std::cout << "OK: no allocations per event" << std::endl;
+    return 0;
+}
@@ -0,0 +1,95 @@
+/**
+ *
+ * @file bench_multicore.cpp
+ * Runs a forking workload of thousands of processes (a mix of CPU-bound,
+ * I/O-bound and mixed programs) under the scheduler on 1, 2, 4, ... cores, and
+ * compares the makespan, the speedup over one core, how busy the cores were and
+ * how much work they stole from each other. Also checks that every process
+ * ends and that the CPU bursts add up to the same time whatever the cores.
+ *
+ */
+
+#include "scheduler.hpp"
+#include "bench_common.hpp"
+
+#include<chrono>
+#include<random>
+
+std::string make_program(int kind, std::mt19937& random) {
+    std::string program;
+    for(int step = 0; step < 8; step++) {
+        if(kind == 0) {
+            program += "CPU, " + std::to_string(150 + random() % 100) + "\n";
+        } else if(kind == 1) {
+            program += "CPU, " + std::to_string(5 + random() % 10) + "\nSYSCALL, " + std::to_string(random() % 20) + "\n";
+        } else {
+            program += "CPU, " + std::to_string(40 + random() % 40) + "\n";
+            if(step % 2 == 0) {
+                program += "SYSCALL, " + std::to_string(random() % 20) + "\n";
+            }
+        }
+    }
+    return program;
+}
+
+//init forks 'children' processes, each of which EXECs one of the workload programs
+compiled_trace_t make_workload(int children) {
+    std::mt19937 random(17);
+    std::string trace = fork_exec_trace(children, [&] { return "worker" + std::to_string(random() % 3); });
+    return compile_workload(trace, [&](const std::string& name) { return make_program(name.back() - '0', random); });
+}
+
+int main() {
+    std::vector<external_file> external_files = {{"worker0", 4, 0}, {"worker1", 4, 0}, {"worker2", 4, 0}};
+    simulation_context_t context = bench_context(bench_delays(), external_files);
+
+    const int children = 2000;
+    compiled_trace_t compiled = make_workload(children);
+    bool ok = true;
+
+    for(scheduling_policy_t policy : {scheduling_policy_t::FCFS, scheduling_policy_t::ROUND_ROBIN}) {
+        std::cout << children << " processes, " << scheduling_policy_name(policy) << std::endl;
+        std::cout << std::setw(8) << "cores" << std::setw(14) << "makespan ms" << std::setw(10) << "speedup" << std::setw(14) << "utilization"
+                  << std::setw(10) << "steals" << std::setw(12) << "sim ms" << std::endl;
+
+        int64_t one_core = 0;
+        int64_t user_time = -1;
+        for(uint32_t cores : {1, 2, 4, 8, 16, 32}) {
+            machine_t machine(allocation_policy_t::BEST_FIT, std::vector<unsigned int>(children + 1, 4));
+            null_sink_t execution;
+            null_sink_t system_status;
+            text_event_log_t log(execution, system_status, context.vectors);
+            scheduler_config_t config{policy, DEFAULT_QUANTUM, io_model_t::IDEAL, cores};
+            scheduler_metrics_t metrics;
+            auto start = std::chrono::steady_clock::now();
+            schedule_trace(compiled, ROOT_PROGRAM, 0, context, machine, PCB(0, -1, "init", 1, -1), config, log, metrics);
+            double sim_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            int64_t makespan = metrics.end - metrics.start;
+            int64_t user = 0;
+            uint64_t steals = 0;
+            for(const core_metrics_t& core : metrics.cores) {
+                user += core.user;
+                steals += core.steals;
+            }
+            if(cores == 1) {
+                one_core = makespan;
+                user_time = user;
+            }
+            ok = ok && metrics.completed == metrics.processes && user == user_time;
+
+            std::cout << std::fixed << std::setprecision(2);
+            std::cout << std::setw(8) << cores << std::setw(14) << makespan << std::setw(10) << static_cast<double>(one_core) / makespan
+                      << std::setw(13) << 100.0 * (makespan * cores - metrics.idle) / (makespan * cores) << "%"
+                      << std::setw(10) << steals << std::setw(12) << sim_ms << std::endl;
+            std::cout << std::defaultfloat;
+        }
+        std::cout << std::endl;
+    }
+
+    if(!ok) {
+        std::cout << "FAIL: a process did not end, or the CPU bursts did not add up to the same time on every core count" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,104 @@
+/**
+ *
+ * @file bench_program_cache.cpp
+ * Compiles an EXEC-heavy trace many times (as a batch of scenarios that share
+ * their programs would), reading every program file afresh each time vs. through
+ * a shared program cache, and reports the time and cache hits/misses. Each way's
+ * last compiled trace is then run, and the two logs must match.
+ *
+ */
+
+#include "simulator.hpp"
+#include "bench_common.hpp"
+
+#include<chrono>
+#include<filesystem>
+#include<random>
+
+namespace fs = std::filesystem;
+
+//The way compile_trace read programs before the cache: a stream per file, line by line
+compiled_trace_t compile_uncached(const std::string& trace_filename, const std::string& program_prefix) {
+    compiled_trace_t compiled;
+    compiled.programs.emplace_back("init");
+
+    std::ifstream input_file(trace_filename);
+    compile_stream(input_file, ROOT_PROGRAM, compiled);
+    for(uint32_t id = ROOT_PROGRAM + 1; id < compiled.programs.size(); id++) {
+        std::ifstream program_file(program_prefix + compiled.programs[id].program_name + ".txt");
+        compile_stream(program_file, id, compiled);
+    }
+
+    build_branch_tables(compiled);
+    return compiled;
+}
+
+int main() {
+    fs::path dir = fs::temp_directory_path() / "bench_program_cache";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    std::string prefix = (dir / "").string();
+
+    //init forks 200 children, each EXECing one of 8 programs of 20000 lines
+    std::mt19937 random(3);
+    const int programs = 8;
+    std::string trace;
+    std::string external_files;
+    for(int child = 0; child < 200; child++) {
+        trace += "FORK, 10\nIF_CHILD, 0\nEXEC program" + std::to_string(child % programs) + ", 20\nIF_PARENT, 0\nCPU, 5\nENDIF, 0\n";
+    }
+    for(int p = 0; p < programs; p++) {
+        std::string program;
+        for(int line = 0; line < 10000; line++) {
+            program += "CPU, " + std::to_string(random() % 100) + "\nEND_IO, " + std::to_string(random() % 20) + "\n";
+        }
+        write_file(dir / ("program" + std::to_string(p) + ".txt"), program);
+        external_files += "program" + std::to_string(p) + ", 1\n";
+    }
+    write_file(dir / "trace.txt", trace);
+
+    std::vector<external_file> files;
+    for(int p = 0; p < programs; p++) {
+        files.push_back({"program" + std::to_string(p), 1});
+    }
+    simulation_context_t context = bench_context(std::vector<int>(20, 100), files);
+
+    const int runs = 50;
+    std::string trace_file = (dir / "trace.txt").string();
+
+    //compile the trace 'runs' times, then run the last compiled trace and return the size of its log
+    auto compile_all = [&](auto compile, double& ms) {
+        auto start = std::chrono::steady_clock::now();
+        compiled_trace_t compiled;
+        for(int run = 0; run < runs; run++) {
+            compiled = compile();
+        }
+        ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        machine_t machine(allocation_policy_t::BEST_FIT, std::vector<unsigned int>(256, 4));  //a partition for every child
+        null_sink_t execution;
+        null_sink_t system_status;
+        text_event_log_t log(execution, system_status, context.vectors);
+        simulate_trace(compiled, ROOT_PROGRAM, 0, context, machine, PCB(0, -1, "init", 1, -1), log);
+        execution.flush();
+        return execution.bytes;
+    };
+
+    double uncached_ms = 0.0;
+    double cached_ms = 0.0;
+    size_t uncached_bytes = compile_all([&] { return compile_uncached(trace_file, prefix); }, uncached_ms);
+
+    program_cache_t cache;
+    size_t cached_bytes = compile_all([&] { return compile_trace(trace_file, prefix, &cache); }, cached_ms);
+
+    std::cout << runs << " compiles of a trace with 200 EXECs of " << programs << " programs (20000 lines each)" << std::endl;
+    std::cout << "  reread every time: " << std::fixed << std::setprecision(1) << uncached_ms << " ms" << std::endl;
+    std::cout << "  program cache:     " << cached_ms << " ms (" << cache.hits << " hits, " << cache.misses << " misses)" << std::endl;
+
+    fs::remove_all(dir);
+    if(uncached_bytes != cached_bytes) {
+        std::cout << "FAIL: the logs differ" << std::endl;
+        return 1;
+    }
+    return 0;
+}
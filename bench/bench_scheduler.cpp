@@ -0,0 +1,87 @@
+/**
+ *
+ * @file bench_scheduler.cpp
+ * Runs one large synthetic workload (init forking a mix of CPU-bound, I/O-bound
+ * and mixed programs) under each scheduling policy and compares their throughput,
+ * turnaround and wait times.
+ *
+ */
+
+#include "scheduler.hpp"
+#include "bench_common.hpp"
+
+#include<chrono>
+#include<map>
+#include<random>
+
+//The programs the children EXEC, with their priorities (lower runs first)
+const std::map<std::string, int> workload_priorities = {{"io_bound", 0}, {"mixed", 1}, {"cpu_bound", 2}};
+
+std::string make_program(const std::string& name, std::mt19937& random) {
+    std::uniform_int_distribution<int> device(0, 19);
+    std::string program;
+
+    for(int step = 0; step < 8; step++) {
+        if(name == "cpu_bound") {
+            program += "CPU, " + std::to_string(150 + random() % 100) + "\n";
+        } else if(name == "io_bound") {
+            program += "CPU, " + std::to_string(5 + random() % 10) + "\nSYSCALL, " + std::to_string(device(random)) + "\n";
+        } else {
+            program += "CPU, " + std::to_string(40 + random() % 40) + "\n";
+            if(step % 2 == 0) {
+                program += "SYSCALL, " + std::to_string(device(random)) + "\n";
+            }
+        }
+    }
+    return program;
+}
+
+//init forks 'children' processes, each of which EXECs one of the workload programs
+compiled_trace_t make_workload(int children) {
+    std::mt19937 random(11);
+    std::vector<std::string> names;
+    for(const auto& [name, priority] : workload_priorities) {
+        names.push_back(name);
+    }
+
+    std::string trace = fork_exec_trace(children, [&] { return names[random() % names.size()]; });
+    return compile_workload(trace, [&](const std::string& name) { return make_program(name, random); });
+}
+
+int main() {
+    std::vector<external_file> external_files;
+    for(const auto& [name, priority] : workload_priorities) {
+        external_files.push_back({name, 4, priority});
+    }
+    simulation_context_t context = bench_context(bench_delays(), external_files);
+
+    std::vector<scheduler_config_t> configs = {
+        {scheduling_policy_t::FCFS, DEFAULT_QUANTUM},
+        {scheduling_policy_t::PRIORITY, DEFAULT_QUANTUM},
+        {scheduling_policy_t::ROUND_ROBIN, 20},
+        {scheduling_policy_t::ROUND_ROBIN, 50},
+        {scheduling_policy_t::ROUND_ROBIN, 200}};
+
+    for(int children : {500, 2000}) {
+        compiled_trace_t compiled = make_workload(children);
+        std::cout << children << " processes" << std::endl;
+
+        for(const auto& config : configs) {
+            //enough memory for every child, so that allocation never fails
+            machine_t machine(allocation_policy_t::BEST_FIT, std::vector<unsigned int>(children + 1, 4));
+
+            null_sink_t execution;
+            null_sink_t system_status;
+            text_event_log_t log(execution, system_status, context.vectors);
+            scheduler_metrics_t metrics;
+            auto start = std::chrono::steady_clock::now();
+            schedule_trace(compiled, ROOT_PROGRAM, 0, context, machine, PCB(0, -1, "init", 1, -1), config, log, metrics);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            print_scheduler_metrics(std::cout, metrics);
+            std::cout << "  simulated in " << std::fixed << std::setprecision(3) << seconds << " s" << std::defaultfloat << std::endl;
+        }
+        std::cout << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,122 @@
+/**
+ *
+ * @file bench_status_delta.cpp
+ * Runs a scheduled workload of thousands of processes, where every FORK and EXEC
+ * snapshots the whole process table, with the text status log and with the delta
+ * status log. Compares their size and write time, and the time to get the table
+ * at a given time back from each. Also checks that the delta log rebuilds the
+ * same text.
+ *
+ */
+
+#include "scheduler.hpp"
+#include "status_delta.hpp"
+#include "bench_common.hpp"
+
+#include<chrono>
+#include<random>
+
+//init forks 'children' processes, each of which EXECs a short program doing some I/O
+compiled_trace_t make_workload(int children) {
+    std::mt19937 random(5);
+    std::string trace = fork_exec_trace(children, [&] { return "worker" + std::to_string(random() % 3); });
+    return compile_workload(trace, [&](const std::string&) { return "CPU, 30\nSYSCALL, " + std::to_string(random() % 20) + "\nCPU, 20\n"; });
+}
+
+double elapsed_ms(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+//The last table at or before 'time' in the text of system_status.txt, found the way a script would: by reading it all
+std::string_view table_from_text(std::string_view text, int time) {
+    std::string_view table;
+    size_t start = text.find("time: ");
+    while(start != std::string_view::npos) {
+        size_t next = text.find("time: ", start + 1);
+        if(std::atoi(text.data() + start + 6) > time) {
+            break;
+        }
+        table = text.substr(start, next == std::string_view::npos ? std::string_view::npos : next - start);
+        start = next;
+    }
+    return table;
+}
+
+int main() {
+    std::vector<external_file> external_files = {{"worker0", 4, 0}, {"worker1", 4, 0}, {"worker2", 4, 0}};
+    simulation_context_t context = bench_context(std::vector<int>(20, 100), external_files);
+    scheduler_config_t config{scheduling_policy_t::FCFS, DEFAULT_QUANTUM};
+
+    const int children = 3000;
+    compiled_trace_t compiled = make_workload(children);
+
+    null_sink_t execution;
+    memory_sink_t text_status;
+    memory_sink_t delta_status;
+    double text_ms, delta_ms;
+    {
+        machine_t machine(allocation_policy_t::BEST_FIT, std::vector<unsigned int>(children + 1, 4));
+        text_event_log_t log(execution, text_status, context.vectors);
+        scheduler_metrics_t metrics;
+        auto start = std::chrono::steady_clock::now();
+        schedule_trace(compiled, ROOT_PROGRAM, 0, context, machine, PCB(0, -1, "init", 1, -1), config, log, metrics);
+        text_status.flush();
+        text_ms = elapsed_ms(start);
+    }
+    {
+        machine_t machine(allocation_policy_t::BEST_FIT, std::vector<unsigned int>(children + 1, 4));
+        null_sink_t unused;
+        text_event_log_t events(execution, unused, context.vectors);
+        delta_status_log_t log(events, delta_status);
+        scheduler_metrics_t metrics;
+        auto start = std::chrono::steady_clock::now();
+        schedule_trace(compiled, ROOT_PROGRAM, 0, context, machine, PCB(0, -1, "init", 1, -1), config, log, metrics);
+        log.finish();
+        delta_ms = elapsed_ms(start);
+    }
+
+    std::string error;
+    status_delta_t delta;
+    if(!open_status_delta(delta_status.str(), delta, error)) {
+        std::cout << "FAIL: " << error << std::endl;
+        return 1;
+    }
+
+    //the table at a few times through the run, from the text and from the delta log
+    std::string_view text = text_status.str();
+    const char* last = text.data() + text.rfind("time: ") + 6;
+    int end_time = std::atoi(last);
+    double text_lookup_ms = 0, delta_lookup_ms = 0;
+    bool same = true;
+    null_sink_t no_execution;
+    for(int step = 1; step <= 10; step++) {
+        int time = end_time / 10 * step;
+        auto start = std::chrono::steady_clock::now();
+        std::string_view expected = table_from_text(text, time);
+        text_lookup_ms += elapsed_ms(start);
+
+        memory_sink_t rebuilt;
+        text_event_log_t renderer(no_execution, rebuilt, context.vectors);
+        start = std::chrono::steady_clock::now();
+        int snapshots = replay_status_delta(delta, status_delta_seek(delta, time), time, true, renderer, error);
+        delta_lookup_ms += elapsed_ms(start);
+        same = same && snapshots > 0 && rebuilt.str() == expected;
+    }
+
+    std::cout << children << " processes, " << delta.checkpoints.size() << " checkpoints" << std::endl;
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << std::setw(10) << "status" << std::setw(12) << "KiB" << std::setw(12) << "write ms" << std::setw(16) << "10 lookups ms" << std::endl;
+    std::cout << std::setw(10) << "text" << std::setw(12) << text.size() / 1024.0 << std::setw(12) << text_ms << std::setw(16) << text_lookup_ms << std::endl;
+    std::cout << std::setw(10) << "delta" << std::setw(12) << delta_status.str().size() / 1024.0 << std::setw(12) << delta_ms << std::setw(16) << delta_lookup_ms << std::endl;
+
+    //all of it rebuilt gives the same text
+    memory_sink_t rebuilt;
+    text_event_log_t renderer(no_execution, rebuilt, context.vectors);
+    same = same && replay_status_delta(delta, sizeof(status_delta_header_t), INT32_MAX, false, renderer, error) > 0 && rebuilt.str() == text;
+
+    if(!same) {
+        std::cout << "FAIL: the delta status log does not rebuild the text status log " << error << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,282 @@
+/**
+ *
+ * @file bench_suite.cpp
+ * Generates synthetic workloads (see workload_generator.hpp), runs bin/interrupts
+ * on each in its own process and measures the wall time and the peak RSS of the
+ * run. The results are compared against a stored baseline so that a change that
+ * slows down the simulator, makes it use more memory or changes its output is
+ * caught. --update-baseline stores the current results as the new baseline.
+ *
+ */
+
+#include "workload_generator.hpp"
+
+#include<chrono>
+#include<cstring>
+#include<functional>
+#include<iomanip>
+#include<iostream>
+#include<map>
+#include<sstream>
+
+#include<fcntl.h>
+#include<sys/resource.h>
+#include<sys/wait.h>
+#include<unistd.h>
+
+struct suite_options_t {
+    int                     scale = 1;          //!< multiplies the size of every workload
+    int                     repeat = 3;         //!< runs per workload; the fastest one counts
+    double                  tolerance = 0.25;   //!< how much slower or bigger than the baseline is still fine
+    bool                    update = false;
+    std::filesystem::path   baseline = "bench/baseline.txt";
+    std::filesystem::path   simulator = "bin/interrupts";
+    std::filesystem::path   work_dir = "bench_workloads";
+};
+
+struct suite_result_t {
+    double      seconds = 0;
+    long        peak_rss_kb = 0;
+    uint64_t    output_hash = 0;    //!< of execution.txt and system_status.txt
+};
+
+//A workload of the suite: how to generate it and the options it runs with on top of its own
+struct suite_entry_t {
+    std::string                                                         name;
+    std::function<workload_t(const std::filesystem::path&, int scale)>  generate;
+    std::vector<std::string>                                            options;
+};
+
+std::vector<suite_entry_t> make_suite() {
+    return {
+        {"fork_tree",       [](auto& dir, int scale) { return generate_fork_tree(dir, 4, 5 + scale); }, {}},
+        {"fork_tree_fcfs",  [](auto& dir, int scale) { return generate_fork_tree(dir, 3 + scale, 5); }, {"--scheduler=fcfs"}},
+        {"exec_chain",      [](auto& dir, int scale) { return generate_exec_chain(dir, 2000 * scale, 17); }, {}},
+        {"io_storm",        [](auto& dir, int scale) { return generate_io_storm(dir, 200000 * scale, 29); }, {}},
+        {"io_storm_rr",     [](auto& dir, int scale) { return generate_io_storm(dir, 200000 * scale, 29); }, {"--scheduler=rr", "--quantum=20"}},
+        {"memory_pressure", [](auto& dir, int scale) { return generate_memory_pressure(dir, 5000 * scale, 41); }, {}},
+    };
+}
+
+//FNV-1a of a file, chained on to 'hash'
+uint64_t hash_file(const std::filesystem::path& filename, uint64_t hash) {
+    std::ifstream file(filename, std::ios::binary);
+    char buffer[1 << 16];
+    while(file.read(buffer, sizeof(buffer)) || file.gcount() > 0) {
+        for(std::streamsize i = 0; i < file.gcount(); i++) {
+            hash = (hash ^ static_cast<unsigned char>(buffer[i])) * 1099511628211ull;
+        }
+    }
+    return hash;
+}
+
+/**
+ * \brief run the simulator once on a generated workload
+ *
+ * The simulator runs in a child process in the workload's directory, with its
+ * console output thrown away. Its peak RSS comes from the kernel (wait4), so it
+ * covers everything the run touched, not only the heap.
+ *
+ * @param dir the workload's directory
+ * @param arguments the simulator and its arguments
+ * @param result filled with the time and peak RSS of the run
+ * @return false if the simulator could not be run or did not exit with 0
+ *
+ */
+bool run_workload(const std::filesystem::path& dir, const std::vector<std::string>& arguments, suite_result_t& result) {
+    std::vector<char*> argv;
+    for(const std::string& argument : arguments) {
+        argv.push_back(const_cast<char*>(argument.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid = fork();
+    if(pid < 0) {
+        return false;
+    }
+    if(pid == 0) {
+        int null = open("/dev/null", O_WRONLY);
+        if(chdir(dir.c_str()) != 0 || null < 0) {
+            _exit(127);
+        }
+        dup2(null, STDOUT_FILENO);
+        dup2(null, STDERR_FILENO);
+        execv(argv[0], argv.data());
+        _exit(127);
+    }
+
+    int status = 0;
+    struct rusage usage;
+    if(wait4(pid, &status, 0, &usage) != pid) {
+        return false;
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.peak_rss_kb = usage.ru_maxrss;   //KiB on Linux
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+//The baseline file: a "scale <n>" line, then "<workload> <seconds> <peak RSS KiB> <output hash>" per workload
+bool load_baseline(const std::filesystem::path& filename, int& scale, std::map<std::string, suite_result_t>& baseline) {
+    std::ifstream file(filename);
+    if(!file.is_open()) {
+        return false;
+    }
+    std::string line;
+    while(std::getline(file, line)) {
+        if(line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream fields(line);
+        std::string name;
+        fields >> name;
+        if(name == "scale") {
+            fields >> scale;
+            continue;
+        }
+        suite_result_t result;
+        fields >> result.seconds >> result.peak_rss_kb >> std::hex >> result.output_hash;
+        if(fields) {
+            baseline[name] = result;
+        }
+    }
+    return true;
+}
+
+bool save_baseline(const std::filesystem::path& filename, int scale, const std::vector<std::pair<std::string, suite_result_t>>& results) {
+    std::ofstream file(filename);
+    if(!file.is_open()) {
+        return false;
+    }
+    file << "# written by bin/bench_suite --update-baseline: workload, seconds, peak RSS (KiB), hash of the logs\n";
+    file << "scale " << scale << "\n";
+    for(const auto& [name, result] : results) {
+        file << name << " " << std::fixed << std::setprecision(4) << result.seconds << " " << result.peak_rss_kb
+             << " " << std::hex << std::setw(16) << std::setfill('0') << result.output_hash << std::dec << std::setfill(' ') << "\n";
+    }
+    return true;
+}
+
+suite_options_t parse_suite_options(int argc, char** argv) {
+    suite_options_t options;
+    for(int i = 1; i < argc; i++) {
+        std::string_view option(argv[i]);
+        size_t equals = option.find('=');
+        std::string_view name = option.substr(0, equals);
+        std::string value(equals == std::string_view::npos ? std::string_view() : option.substr(equals + 1));
+
+        if(name == "--scale") {
+            options.scale = std::atoi(value.c_str());
+        } else if(name == "--repeat") {
+            options.repeat = std::atoi(value.c_str());
+        } else if(name == "--tolerance") {
+            options.tolerance = std::atof(value.c_str());
+        } else if(name == "--baseline") {
+            options.baseline = value;
+        } else if(name == "--simulator") {
+            options.simulator = value;
+        } else if(name == "--work-dir") {
+            options.work_dir = value;
+        } else if(name == "--update-baseline") {
+            options.update = true;
+        } else {
+            std::cerr << "Error: Unknown option: " << option << std::endl;
+            std::cerr << "Usage: ./bench_suite [--scale=<n>] [--repeat=<n>] [--tolerance=<fraction>] [--baseline=<file>] [--simulator=<binary>] [--work-dir=<directory>] [--update-baseline]" << std::endl;
+            exit(1);
+        }
+    }
+    if(options.scale < 1 || options.repeat < 1 || options.tolerance < 0) {
+        std::cerr << "Error: --scale and --repeat must be at least 1, --tolerance at least 0" << std::endl;
+        exit(1);
+    }
+    return options;
+}
+
+int main(int argc, char** argv) {
+    suite_options_t options = parse_suite_options(argc, argv);
+    //the workloads run in their own directories, so every path given to the simulator is absolute
+    std::filesystem::path simulator = std::filesystem::absolute(options.simulator);
+    std::filesystem::path vector_table = std::filesystem::absolute("vector_table.txt");
+    std::filesystem::path device_table = std::filesystem::absolute("device_table.txt");
+    if(!std::filesystem::exists(simulator) || !std::filesystem::exists(vector_table) || !std::filesystem::exists(device_table)) {
+        std::cerr << "Error: run from the repository root after ./build.sh (needs " << options.simulator.string() << ", vector_table.txt and device_table.txt)" << std::endl;
+        exit(1);
+    }
+
+    int baseline_scale = 0;
+    std::map<std::string, suite_result_t> baseline;
+    bool have_baseline = !options.update && load_baseline(options.baseline, baseline_scale, baseline);
+    if(have_baseline && baseline_scale != options.scale) {
+        std::cerr << "Error: the baseline was measured at --scale=" << baseline_scale << ", not " << options.scale << std::endl;
+        exit(1);
+    }
+
+    std::vector<std::pair<std::string, suite_result_t>> results;
+    int regressions = 0;
+    std::cout << std::fixed;
+    std::cout << std::setw(16) << "workload" << std::setw(10) << "seconds" << std::setw(10) << "baseline"
+              << std::setw(12) << "peak KiB" << std::setw(12) << "baseline" << "  result" << std::endl;
+
+    for(const suite_entry_t& entry : make_suite()) {
+        std::filesystem::path dir = options.work_dir / entry.name;
+        workload_t workload = entry.generate(dir, options.scale);
+
+        std::vector<std::string> arguments = {simulator.string(), "trace.txt", vector_table.string(), device_table.string(), "external_files.txt"};
+        arguments.insert(arguments.end(), workload.options.begin(), workload.options.end());
+        arguments.insert(arguments.end(), entry.options.begin(), entry.options.end());
+
+        suite_result_t best;
+        for(int run = 0; run < options.repeat; run++) {
+            suite_result_t result;
+            if(!run_workload(dir, arguments, result)) {
+                std::cerr << "Error: the simulator failed on workload " << entry.name << " (in " << dir.string() << ")" << std::endl;
+                exit(1);
+            }
+            if(run == 0 || result.seconds < best.seconds) {
+                best.seconds = result.seconds;
+            }
+            best.peak_rss_kb = std::max(best.peak_rss_kb, result.peak_rss_kb);
+        }
+        best.output_hash = hash_file(dir / "system_status.txt", hash_file(dir / "execution.txt", 14695981039346656037ull));
+        results.push_back({entry.name, best});
+
+        std::cout << std::setw(16) << entry.name << std::setprecision(3) << std::setw(10) << best.seconds;
+        auto found = baseline.find(entry.name);
+        if(found == baseline.end()) {
+            std::cout << std::setw(10) << "-" << std::setw(12) << best.peak_rss_kb << std::setw(12) << "-" << "  " << (options.update ? "stored" : "no baseline") << std::endl;
+            continue;
+        }
+
+        //a small absolute slack keeps very short runs from failing on noise
+        const suite_result_t& base = found->second;
+        std::string verdict;
+        if(best.seconds > base.seconds * (1 + options.tolerance) + 0.05) {
+            verdict += " SLOWER";
+        }
+        if(best.peak_rss_kb > base.peak_rss_kb * (1 + options.tolerance) + 1024) {
+            verdict += " BIGGER";
+        }
+        if(best.output_hash != base.output_hash) {
+            verdict += " OUTPUT-CHANGED";
+        }
+        regressions += !verdict.empty();
+        std::cout << std::setw(10) << base.seconds << std::setw(12) << best.peak_rss_kb << std::setw(12) << base.peak_rss_kb
+                  << "  " << (verdict.empty() ? "ok" : "REGRESSION:" + verdict) << std::endl;
+    }
+
+    if(options.update) {
+        if(!save_baseline(options.baseline, options.scale, results)) {
+            std::cerr << "Error: Unable to write " << options.baseline.string() << std::endl;
+            exit(1);
+        }
+        std::cout << "Baseline written to " << options.baseline.string() << std::endl;
+    } else if(!have_baseline) {
+        std::cout << "No baseline in " << options.baseline.string() << "; run with --update-baseline to store one" << std::endl;
+    }
+
+    if(regressions > 0) {
+        std::cout << "FAIL: " << regressions << " workload(s) regressed against the baseline" << std::endl;
+        return 1;
+    }
+    return 0;
+}
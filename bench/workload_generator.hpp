@@ -0,0 +1,130 @@
+#ifndef WORKLOAD_GENERATOR_HPP_
+#define WORKLOAD_GENERATOR_HPP_
+
+#include<filesystem>
+#include<fstream>
+#include<random>
+#include<string>
+#include<vector>
+
+//Synthetic inputs for the simulator: a trace, the programs it EXECs and the
+//external files table, written to a directory. The same shape, size and seed
+//always give the same files.
+struct workload_t {
+    std::string                 name;
+    std::vector<std::string>    options;    //!< simulator options the workload is meant to run with
+};
+
+struct workload_writer_t {
+    std::filesystem::path   dir;
+    std::string             external_files;
+
+    explicit workload_writer_t(const std::filesystem::path& _dir): dir(_dir) {
+        std::filesystem::remove_all(dir);
+        std::filesystem::create_directories(dir);
+    }
+
+    void write(const std::string& filename, const std::string& contents) {
+        std::ofstream file(dir / filename, std::ios::binary);
+        file << contents;
+    }
+
+    //Writes a program file and lists it in the external files table
+    void program(const std::string& name, const std::string& code, unsigned int size) {
+        write(name + ".txt", code);
+        external_files += name + ", " + std::to_string(size) + "\n";
+    }
+
+    void finish(const std::string& trace) {
+        write("trace.txt", trace);
+        write("external_files.txt", external_files);
+    }
+};
+
+//A FORK block: the child EXECs 'program', the parent runs a CPU burst
+std::string fork_exec_block(const std::string& program) {
+    return "FORK, 5\nIF_CHILD, 0\nEXEC " + program + ", 10\nIF_PARENT, 0\nCPU, 20\nENDIF, 0\n";
+}
+
+/**
+ * \brief a tree of processes 'width' wide and 'depth' deep
+ *
+ * Every process forks 'width' children, each of which EXECs the program of the
+ * next level down; the last level only computes and does I/O. That is
+ * width + width^2 + ... + width^depth processes.
+ */
+workload_t generate_fork_tree(const std::filesystem::path& dir, int width, int depth) {
+    workload_writer_t writer(dir);
+    auto level = [&](int d) {
+        std::string code;
+        if(d == depth) {
+            code = "CPU, 30\nSYSCALL, 4\nCPU, 10\nEND_IO, 4\n";
+        } else {
+            for(int w = 0; w < width; w++) {
+                code += fork_exec_block("level" + std::to_string(d + 1));
+            }
+        }
+        return code;
+    };
+    for(int d = 1; d <= depth; d++) {
+        writer.program("level" + std::to_string(d), level(d), 1);
+    }
+    writer.finish(level(0));
+    //every process holds a partition until its parent's branch is done
+    int processes = 1;
+    for(int d = 0, count = 1; d < depth; d++) {
+        count *= width;
+        processes += count;
+    }
+    return {"fork_tree", {"--partitions=" + std::to_string(processes + 1)}};
+}
+
+//A chain of 'length' programs, each computing a little and EXECing the next
+workload_t generate_exec_chain(const std::filesystem::path& dir, int length, unsigned seed) {
+    workload_writer_t writer(dir);
+    std::mt19937 random(seed);
+    for(int p = 0; p < length; p++) {
+        std::string code = "CPU, " + std::to_string(random() % 50 + 1) + "\nSYSCALL, " + std::to_string(random() % 19) + "\n";
+        if(p + 1 < length) {
+            code += "EXEC chain" + std::to_string(p + 1) + ", " + std::to_string(random() % 20 + 1) + "\n";
+        }
+        writer.program("chain" + std::to_string(p), code, random() % 40 + 1);
+    }
+    writer.finish("CPU, 10\nEXEC chain0, 10\n");
+    return {"exec_chain", {}};
+}
+
+//'lines' lines of SYSCALL and END_IO with short CPU bursts, in one process and a few forked children
+workload_t generate_io_storm(const std::filesystem::path& dir, int lines, unsigned seed) {
+    workload_writer_t writer(dir);
+    std::mt19937 random(seed);
+    std::string io;
+    for(int i = 0; i < lines / 2; i++) {
+        io += (random() % 2 ? "SYSCALL, " : "END_IO, ") + std::to_string(random() % 19) + "\nCPU, " + std::to_string(random() % 10 + 1) + "\n";
+    }
+    writer.program("worker", io, 5);
+    std::string trace;
+    for(int child = 0; child < 4; child++) {
+        trace += fork_exec_block("worker");
+    }
+    writer.finish(trace + io);
+    return {"io_storm", {}};
+}
+
+//'children' processes EXECing programs of random sizes into a small partition table
+workload_t generate_memory_pressure(const std::filesystem::path& dir, int children, unsigned seed) {
+    workload_writer_t writer(dir);
+    std::mt19937 random(seed);
+    const int programs = 16;
+    for(int p = 0; p < programs; p++) {
+        writer.program("job" + std::to_string(p), "CPU, 25\nSYSCALL, 3\nCPU, 5\n", random() % 40 + 1);
+    }
+    std::string trace;
+    for(int child = 0; child < children; child++) {
+        trace += fork_exec_block("job" + std::to_string(random() % programs));
+    }
+    writer.finish(trace);
+    return {"memory_pressure", {"--partitions=32", "--allocator=first"}};
+}
+
+#endif
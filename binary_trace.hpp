@@ -0,0 +1,340 @@
+#ifndef BINARY_TRACE_HPP_
+#define BINARY_TRACE_HPP_
+
+#include<cstddef>
+#include<cstring>
+#include<stdexcept>
+
+#include "compiled_trace.hpp"
+
+//A compiled trace saved to disk (see write_binary_trace). The simulator maps the
+//file into memory and runs the instructions straight out of it, so starting a run
+//does not parse any text. Everything is stored in the byte order of the machine
+//that wrote it; a file from a machine with the other byte order is rejected.
+//
+//  header
+//  program table       binary_program_t per program
+//  views               per view: program, range count, resolved, fork count (uint32 each),
+//                      then its ranges (begin, end) and its forks (FORK index, child view,
+//                      parent resume range, parent resume index, endif)
+//  exec targets        uint32 per EXEC name of each program (trace-wide program ids)
+//  string table        the program names, not terminated
+//  code                instruction_t per line of each program
+#define BINARY_TRACE_MAGIC      "SIMTRACE"
+#define BINARY_TRACE_VERSION    1
+#define BINARY_TRACE_BYTE_ORDER 0x01020304u
+
+struct binary_trace_header_t {
+    char        magic[8];
+    uint32_t    byte_order;
+    uint32_t    version;
+    uint32_t    program_count;
+    uint32_t    view_count;
+    uint64_t    programs_offset;
+    uint64_t    views_offset;
+    uint64_t    views_size;         //!< in uint32 words
+    uint64_t    file_size;
+};
+
+struct binary_program_t {
+    uint32_t    name_offset;        //!< in the string table
+    uint32_t    name_length;
+    uint64_t    code_offset;
+    uint32_t    code_count;
+    uint32_t    exec_count;
+    uint64_t    exec_offset;
+};
+
+//The code section is the in-memory instruction_t, so it must not depend on the compiler's whims
+static_assert(sizeof(instruction_t) == 12, "instruction_t is stored as a 12 byte record");
+static_assert(offsetof(instruction_t, operand) == 4 && offsetof(instruction_t, program) == 8, "unexpected instruction_t layout");
+static_assert(sizeof(binary_trace_header_t) == 56 && sizeof(binary_program_t) == 32, "unexpected binary trace record size");
+
+#define VIEW_WORDS  4   //!< program, range count, resolved, fork count
+#define RANGE_WORDS 2
+#define FORK_WORDS  5
+
+//Pads a buffer with zeros up to a multiple of 8 bytes
+void align_buffer(std::string& buffer) {
+    buffer.resize((buffer.size() + 7) & ~size_t(7), '\0');
+}
+
+template<typename T>
+void append_record(std::string& buffer, const T& record) {
+    buffer.append(reinterpret_cast<const char*>(&record), sizeof(T));
+}
+
+/**
+ * \brief save a compiled trace in the binary format
+ *
+ * Every program, the views built so far and their branch tables are saved, so the
+ * file holds everything needed to run the trace: the program files it EXECs are
+ * not needed any more. Views resolved when the trace was compiled (one per program)
+ * are stored resolved; forked children are resolved when they first run, as usual.
+ *
+ * @param compiled the compiled trace
+ * @param filename where to write it
+ * @return false if the file could not be written
+ *
+ */
+bool write_binary_trace(const compiled_trace_t& compiled, const std::string& filename) {
+    binary_trace_header_t header{};
+    std::memcpy(header.magic, BINARY_TRACE_MAGIC, sizeof(header.magic));
+    header.byte_order = BINARY_TRACE_BYTE_ORDER;
+    header.version = BINARY_TRACE_VERSION;
+    header.program_count = compiled.programs.size();
+    header.view_count = compiled.views.size();
+
+    std::vector<uint32_t> views;
+    for(const auto& view : compiled.views) {
+        views.insert(views.end(), {view.program, static_cast<uint32_t>(view.ranges.size()), view.resolved, static_cast<uint32_t>(view.forks.size())});
+        for(const auto& range : view.ranges) {
+            views.insert(views.end(), {range.begin, range.end});
+        }
+        //sorted, so that the same trace always gives the same file
+        std::map<uint32_t, fork_branch_t> forks(view.forks.begin(), view.forks.end());
+        for(const auto& [index, fork] : forks) {
+            views.insert(views.end(), {index, fork.child_view, fork.parent_resume.range, fork.parent_resume.index, fork.endif});
+        }
+    }
+
+    std::string strings;
+    std::vector<binary_program_t> programs(compiled.programs.size());
+    for(size_t id = 0; id < compiled.programs.size(); id++) {
+        programs[id].name_offset = strings.size();
+        programs[id].name_length = compiled.programs[id].program_name.size();
+        strings += compiled.programs[id].program_name;
+    }
+
+    header.programs_offset = sizeof(header);
+    header.views_offset = header.programs_offset + programs.size() * sizeof(binary_program_t);
+    header.views_size = views.size();
+
+    std::string tail;   //!< everything after the views, starting at tail_offset
+    uint64_t tail_offset = header.views_offset + views.size() * sizeof(uint32_t);
+    tail.resize(((tail_offset + 7) & ~uint64_t(7)) - tail_offset, '\0');
+    for(size_t id = 0; id < compiled.programs.size(); id++) {
+        programs[id].exec_count = compiled.programs[id].exec_targets.size();
+        programs[id].exec_offset = tail_offset + tail.size();
+        for(uint32_t target : compiled.programs[id].exec_targets) {
+            append_record(tail, target);
+        }
+    }
+    uint64_t strings_offset = tail_offset + tail.size();
+    tail += strings;
+    for(auto& program : programs) {
+        program.name_offset += strings_offset;
+    }
+    for(size_t id = 0; id < compiled.programs.size(); id++) {
+        align_buffer(tail);
+        code_span_t code = compiled.programs[id].code();
+        programs[id].code_offset = tail_offset + tail.size();
+        programs[id].code_count = code.size();
+        for(const auto& instruction : code) {
+            //written field by field: the padding after 'op' is zeroed, not copied
+            char record[sizeof(instruction_t)] = {};
+            std::memcpy(record + offsetof(instruction_t, op), &instruction.op, sizeof(instruction.op));
+            std::memcpy(record + offsetof(instruction_t, operand), &instruction.operand, sizeof(instruction.operand));
+            std::memcpy(record + offsetof(instruction_t, program), &instruction.program, sizeof(instruction.program));
+            tail.append(record, sizeof(record));
+        }
+    }
+    header.file_size = tail_offset + tail.size();
+
+    std::ofstream output_file(filename, std::ios::binary);
+    if(!output_file.is_open()) {
+        return false;
+    }
+    output_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    output_file.write(reinterpret_cast<const char*>(programs.data()), programs.size() * sizeof(binary_program_t));
+    output_file.write(reinterpret_cast<const char*>(views.data()), views.size() * sizeof(uint32_t));
+    output_file.write(tail.data(), tail.size());
+    return static_cast<bool>(output_file);
+}
+
+//True if the file starts with the binary trace magic
+bool is_binary_trace(const std::string& filename) {
+    std::ifstream input_file(filename, std::ios::binary);
+    char magic[sizeof(binary_trace_header_t::magic)] = {};
+    input_file.read(magic, sizeof(magic));
+    return input_file && std::memcmp(magic, BINARY_TRACE_MAGIC, sizeof(magic)) == 0;
+}
+
+//True if [offset, offset + count * size) lies inside the file
+bool section_fits(const mapped_file_t& file, uint64_t offset, uint64_t count, uint64_t size) {
+    return offset <= file.size && count <= (file.size - offset) / size;
+}
+
+/**
+ * \brief load a binary trace
+ *
+ * The file is mapped into memory and the programs' code is used in place; only the
+ * views and their branch tables are rebuilt (they are small). Everything the
+ * simulator relies on is checked first (opcodes, EXEC targets, view ranges, fork
+ * entries: one per FORK of a resolved view, each on a FORK), so a corrupt file is
+ * rejected here instead of misbehaving later.
+ *
+ * @param filename the binary trace
+ * @return the compiled trace (its programs keep the file mapped)
+ * @throws std::runtime_error if the file cannot be read or is not a valid binary trace
+ *
+ */
+compiled_trace_t load_binary_trace(const std::string& filename) {
+    PROFILE_SCOPE(phase_t::LOAD_BINARY);
+    auto file = std::make_shared<mapped_file_t>(filename);
+    auto invalid = [&](const std::string& why) {
+        return std::runtime_error("invalid binary trace " + filename + ": " + why);
+    };
+    if(!file->is_open()) {
+        throw std::runtime_error("unable to open file: " + filename);
+    }
+
+    binary_trace_header_t header;
+    if(file->size < sizeof(header)) {
+        throw invalid("truncated header");
+    }
+    std::memcpy(&header, file->data, sizeof(header));
+    if(std::memcmp(header.magic, BINARY_TRACE_MAGIC, sizeof(header.magic)) != 0) {
+        throw invalid("bad magic");
+    }
+    if(header.byte_order != BINARY_TRACE_BYTE_ORDER) {
+        throw invalid("written on a machine with a different byte order");
+    }
+    if(header.version != BINARY_TRACE_VERSION) {
+        throw invalid("unsupported version " + std::to_string(header.version));
+    }
+    if(header.file_size != file->size || header.program_count == 0
+       || !section_fits(*file, header.programs_offset, header.program_count, sizeof(binary_program_t))
+       || !section_fits(*file, header.views_offset, header.views_size, sizeof(uint32_t))
+       || header.programs_offset % 8 != 0 || header.views_offset % 4 != 0) {
+        throw invalid("bad section table");
+    }
+
+    compiled_trace_t compiled;
+    compiled.programs.resize(header.program_count);
+    for(uint32_t id = 0; id < header.program_count; id++) {
+        binary_program_t record;
+        std::memcpy(&record, file->data + header.programs_offset + id * sizeof(record), sizeof(record));
+        if(!section_fits(*file, record.name_offset, record.name_length, 1)
+           || !section_fits(*file, record.code_offset, record.code_count, sizeof(instruction_t))
+           || !section_fits(*file, record.exec_offset, record.exec_count, sizeof(uint32_t))
+           || record.code_offset % alignof(instruction_t) != 0 || record.exec_offset % 4 != 0) {
+            throw invalid("bad program " + std::to_string(id));
+        }
+
+        program_image_t& image = compiled.programs[id];
+        image.program_name.assign(file->data + record.name_offset, record.name_length);
+        image.owner = file;
+        image.instructions = {reinterpret_cast<const instruction_t*>(file->data + record.code_offset), record.code_count};
+        const uint32_t* targets = reinterpret_cast<const uint32_t*>(file->data + record.exec_offset);
+        image.exec_targets.assign(targets, targets + record.exec_count);
+
+        for(uint32_t target : image.exec_targets) {
+            if(target == ROOT_PROGRAM || target >= header.program_count) {
+                throw invalid("bad EXEC target in program " + std::to_string(id));
+            }
+        }
+        for(const auto& instruction : image.instructions) {
+            uint8_t op = static_cast<uint8_t>(instruction.op);
+            if(op > static_cast<uint8_t>(opcode_t::EXEC) || (instruction.op == opcode_t::EXEC && instruction.program >= record.exec_count)) {
+                throw invalid("bad instruction in program " + std::to_string(id));
+            }
+        }
+        if(id != ROOT_PROGRAM) {
+            compiled.program_ids.emplace(image.program_name, id);
+        }
+    }
+
+    const uint32_t* words = reinterpret_cast<const uint32_t*>(file->data + header.views_offset);
+    const uint32_t* words_end = words + header.views_size;
+    for(uint32_t id = 0; id < header.view_count; id++) {
+        if(words_end - words < VIEW_WORDS) {
+            throw invalid("truncated views");
+        }
+        uint32_t program = words[0], range_count = words[1], resolved = words[2], fork_count = words[3];
+        words += VIEW_WORDS;
+        if(program >= header.program_count || uint64_t(words_end - words) < uint64_t(range_count) * RANGE_WORDS + uint64_t(fork_count) * FORK_WORDS) {
+            throw invalid("bad view " + std::to_string(id));
+        }
+
+        const code_span_t code = compiled.programs[program].code();
+        const size_t code_size = code.size();
+        std::vector<code_range_t> ranges(range_count);
+        for(auto& range : ranges) {
+            range = {words[0], words[1]};
+            words += RANGE_WORDS;
+            if(range.begin > range.end || range.end > code_size) {
+                throw invalid("bad range in view " + std::to_string(id));
+            }
+        }
+        if(intern_view(compiled, program, std::move(ranges)) != id) {
+            throw invalid("duplicate view " + std::to_string(id));
+        }
+
+        trace_view_t& view = compiled.views[id];
+        view.resolved = resolved != 0;
+        for(uint32_t f = 0; f < fork_count; f++) {
+            fork_branch_t fork{words[1], {words[2], words[3]}, words[4]};
+            uint32_t index = words[0];
+            words += FORK_WORDS;
+            if(index >= code_size || fork.child_view >= header.view_count || fork.parent_resume.range >= view.ranges.size()
+               || fork.parent_resume.index < view.ranges[fork.parent_resume.range].begin
+               || fork.parent_resume.index >= view.ranges[fork.parent_resume.range].end
+               || (fork.endif != NO_INDEX && fork.endif >= code_size)
+               || code[index].op != opcode_t::FORK || !view.forks.emplace(index, fork).second) {
+                throw invalid("bad fork in view " + std::to_string(id));
+            }
+        }
+        //the engines look up the branch of every FORK a resolved view runs
+        if(view.resolved) {
+            for(const code_range_t& range : view.ranges) {
+                for(uint32_t index = range.begin; index < range.end; index++) {
+                    if(code[index].op == opcode_t::FORK && view.forks.count(index) == 0) {
+                        throw invalid("missing fork in view " + std::to_string(id));
+                    }
+                }
+            }
+        }
+    }
+    //view i is the whole of program i (EXEC runs a program through its view)
+    if(compiled.views.size() < compiled.programs.size()) {
+        throw invalid("missing program views");
+    }
+    for(uint32_t id = 0; id < compiled.programs.size(); id++) {
+        const trace_view_t& view = compiled.views[id];
+        size_t code_size = compiled.programs[id].code().size();
+        bool whole = code_size == 0 ? view.ranges.empty() : view.ranges.size() == 1 && view.ranges[0].begin == 0 && view.ranges[0].end == code_size;
+        if(view.program != id || !whole) {
+            throw invalid("bad view of program " + std::to_string(id));
+        }
+    }
+    //child views must be interned too, and must belong to the program that forks
+    for(const auto& view : compiled.views) {
+        for(const auto& [index, fork] : view.forks) {
+            if(compiled.views[fork.child_view].program != view.program) {
+                throw invalid("bad fork child");
+            }
+        }
+    }
+
+    return compiled;
+}
+
+/**
+ * \brief load a trace, either a text trace or a binary one
+ *
+ * A binary trace (see write_binary_trace) is mapped and used as is, and holds every
+ * program it EXECs, so 'program_prefix' and 'cache' are not used for it. A text
+ * trace is compiled by compile_trace().
+ *
+ * @throws std::runtime_error for a binary trace that cannot be loaded
+ *
+ */
+compiled_trace_t load_trace(const std::string& trace_filename, const std::string& program_prefix = "", program_cache_t* cache = nullptr) {
+    if(is_binary_trace(trace_filename)) {
+        return load_binary_trace(trace_filename);
+    }
+    return compile_trace(trace_filename, program_prefix, cache);
+}
+
+#endif
@@ -1,6 +1,140 @@
-if [ ! -d "bin" ]; then
-    mkdir bin
-else
-	rm bin/*
+#!/bin/bash
+
+# ./build.sh [<configuration> ...]
+#   release   bin/: the simulator, batch driver and tools at -O3 with LTO, and the benchmarks
+#   debug     bin/: the simulator, batch driver and tools at -g -O0
+#   sanitize  bin/sanitize/: the simulator and batch driver with AddressSanitizer and UBSan
+#   profile   bin/: interrupts_profile and batch_profile, with the SIM_PROFILE instrumentation
+#   pgo       bin/: release, then the simulator and batch driver rebuilt with the profile of a
+#             training run (the benchmark suite's workloads and the test cases)
+#   all       release, sanitize and profile
+# With no configuration: release and profile. Everything builds offline, with g++ only.
+# The compiles run in parallel, $JOBS at a time (default: one per core), with $WARNINGS on
+# in every configuration: the build is expected to be free of warnings.
+
+JOBS=${JOBS:-$(nproc)}
+RELEASE="-O3 -flto=auto"
+DEBUG="-g -O0"
+SANITIZE="-g -O1 -fno-omit-frame-pointer -fsanitize=address,undefined"
+BENCH="-O2"
+WARNINGS="-Wall -Wextra"
+
+failed=0
+pids=()
+
+# build <flags> <output> <source>: starts one compile in the background
+build() {
+    while [ "$(jobs -rp | wc -l)" -ge "$JOBS" ]; do
+        wait -n
+    done
+    echo "g++ $WARNINGS $1 -o $2 $3"
+    rm -f "$2"
+    g++ $WARNINGS $1 -I . -o "$2" "$3" &
+    pids+=($!)
+}
+
+# finish: waits for every compile started so far, exits if one failed
+finish() {
+    for pid in "${pids[@]}"; do
+        wait "$pid" || failed=1
+    done
+    pids=()
+    if [ "$failed" -ne 0 ]; then
+        echo "build.sh: compilation failed" >&2
+        exit 1
+    fi
+}
+
+# programs <flags> <directory>: the simulator, the batch driver and the tools
+programs() {
+    build "$1" "$2/interrupts" interrupts_101259994_101108918.cpp
+    build "$1 -pthread" "$2/batch" batch.cpp
+    build "$1" "$2/trace_convert" trace_convert.cpp
+    build "$1" "$2/log_render" log_render.cpp
+    build "$1" "$2/status_reader" status_reader.cpp
+    build "$1" "$2/whatif" whatif.cpp
+}
+
+sanitized() {
+    mkdir -p bin/sanitize
+    build "$SANITIZE" bin/sanitize/interrupts interrupts_101259994_101108918.cpp
+    build "$SANITIZE -pthread" bin/sanitize/batch batch.cpp
+}
+
+profiled() {
+    build "-O2 -DSIM_PROFILE" bin/interrupts_profile interrupts_101259994_101108918.cpp
+    build "-O2 -DSIM_PROFILE -pthread" bin/batch_profile batch.cpp
+}
+
+benchmarks() {
+    build "$BENCH" bin/bench_branch_table bench/bench_branch_table.cpp
+    build "$BENCH" bin/bench_log_format bench/bench_log_format.cpp
+    build "$BENCH" bin/bench_copy_count bench/bench_copy_count.cpp
+    build "$BENCH" bin/bench_allocator bench/bench_allocator.cpp
+    build "$BENCH" bin/bench_scheduler bench/bench_scheduler.cpp
+    build "$BENCH -pthread" bin/bench_batch bench/bench_batch.cpp
+    build "$BENCH" bin/bench_program_cache bench/bench_program_cache.cpp
+    build "$BENCH" bin/bench_binary_trace bench/bench_binary_trace.cpp
+    build "$BENCH" bin/bench_event_log bench/bench_event_log.cpp
+    build "$BENCH" bin/bench_suite bench/bench_suite.cpp
+    build "$BENCH" bin/bench_status_delta bench/bench_status_delta.cpp
+    build "$BENCH" bin/bench_devices bench/bench_devices.cpp
+    build "$BENCH" bin/bench_multicore bench/bench_multicore.cpp
+}
+
+# The training run writes its profile to _pgo/profile; the programs are rebuilt at the
+# same paths so that the profile files match them.
+pgo() {
+    rm -rf _pgo
+    mkdir -p _pgo
+    build "$RELEASE -fprofile-generate=$PWD/_pgo/profile -fprofile-update=atomic" bin/interrupts interrupts_101259994_101108918.cpp
+    build "$RELEASE -fprofile-generate=$PWD/_pgo/profile -fprofile-update=atomic -pthread" bin/batch batch.cpp
+    finish
+    ./bin/bench_suite --repeat=1 --work-dir=_pgo/workloads --baseline=_pgo/no_baseline.txt > /dev/null || exit 1
+    ./bin/batch tests_manifest.txt --output-dir=_pgo/tests > /dev/null 2>&1 || exit 1
+    build "$RELEASE -fprofile-use=$PWD/_pgo/profile -fprofile-partial-training" bin/interrupts interrupts_101259994_101108918.cpp
+    build "$RELEASE -fprofile-use=$PWD/_pgo/profile -fprofile-partial-training -pthread" bin/batch batch.cpp
+    finish
+}
+
+configurations=("$@")
+if [ ${#configurations[@]} -eq 0 ]; then
+    configurations=(release profile)
 fi
-g++ -g -O0 -I . -o bin/interrupts interrupts_101259994_101108918.cpp
\ No newline at end of file
+
+mkdir -p bin
+
+for configuration in "${configurations[@]}"; do
+    case "$configuration" in
+        release)
+            programs "$RELEASE" bin
+            benchmarks
+            ;;
+        debug)
+            programs "$DEBUG" bin
+            ;;
+        sanitize)
+            sanitized
+            ;;
+        profile)
+            profiled
+            ;;
+        pgo)
+            programs "$RELEASE" bin
+            benchmarks
+            finish
+            pgo
+            ;;
+        all)
+            programs "$RELEASE" bin
+            benchmarks
+            sanitized
+            profiled
+            ;;
+        *)
+            echo "build.sh: unknown configuration '$configuration' (expected release, debug, sanitize, profile, pgo or all)" >&2
+            exit 1
+            ;;
+    esac
+done
+finish
@@ -0,0 +1,187 @@
+#ifndef CHECKPOINT_HPP_
+#define CHECKPOINT_HPP_
+
+#include<algorithm>
+#include<charconv>
+
+#include "simulator.hpp"
+
+#define DEFAULT_CHECKPOINT_INTERVAL 4096    //!< instructions from one checkpoint to the next
+#define DEFAULT_CHECKPOINT_LIMIT    64      //!< checkpoints kept at most
+#define NEVER_USED UINT64_MAX
+
+//A point a run can be resumed from: the state of the simulator and of the machine,
+//and how much of each log had been written
+struct simulation_checkpoint_t {
+    simulator_state_t   state;
+    machine_t           machine;
+    uint64_t            execution_size;
+    uint64_t            status_size;
+};
+
+//One change to the tables a run read, for a what-if run
+enum class whatif_target_t {
+    DEVICE,     //!< the delay of a device
+    VECTOR,     //!< the ISR address of a vector
+    PROGRAM     //!< the size of a program in the external files
+};
+
+struct whatif_change_t {
+    whatif_target_t target;
+    int             number = -1;    //!< device or vector number
+    std::string     name;           //!< program name
+    std::string     value;          //!< delay, address or size
+};
+
+/**
+ * Watches a run of resume_trace: takes a checkpoint every 'interval' instructions
+ * and notes the first instruction that uses each device, vector and program, so
+ * that a run with one of them changed can start from the last checkpoint before
+ * it instead of from the beginning. A checkpoint copies the process stack and the
+ * machine, so it costs the same whatever the length of the run so far.
+ *
+ * At most 'limit' checkpoints are kept: when there would be more, every other one
+ * is dropped and the interval doubles. The checkpoints stay evenly spaced over the
+ * whole run, and a long run keeps a bounded number of them, at the cost of
+ * rerunning up to twice as many instructions from the one before a change.
+ */
+struct checkpoint_recorder_t : simulation_observer_t {
+    const compiled_trace_t&                 compiled;
+    const output_sink_t&                    execution;
+    const output_sink_t&                    system_status;
+    uint64_t                                interval;
+    size_t                                  limit;
+    std::vector<simulation_checkpoint_t>    checkpoints;    //!< checkpoints[i] is before instruction i * interval
+    std::vector<uint64_t>                   device_use;     //!< by device: the first instruction using it, or NEVER_USED
+    std::vector<uint64_t>                   vector_use;     //!< by vector
+    std::vector<uint64_t>                   program_use;    //!< by program id: the first EXEC of it
+
+    //'limit' is rounded up to an even number, at least 2
+    checkpoint_recorder_t(const compiled_trace_t& _compiled, const output_sink_t& _execution, const output_sink_t& _system_status,
+                          uint64_t _interval = DEFAULT_CHECKPOINT_INTERVAL, size_t _limit = DEFAULT_CHECKPOINT_LIMIT):
+        compiled(_compiled), execution(_execution), system_status(_system_status), interval(_interval), limit(std::max<size_t>(_limit + _limit % 2, 2)) {}
+
+    void before_instruction(const simulator_state_t& state, const machine_t& machine, const instruction_t& instruction, uint32_t program) override {
+        if(state.steps % interval == 0) {
+            if(checkpoints.size() == limit) {
+                //keep the checkpoints at multiples of twice the interval; this one is the next of them
+                for(size_t i = 1; i < limit / 2; i++) {
+                    checkpoints[i] = std::move(checkpoints[2 * i]);
+                }
+                checkpoints.erase(checkpoints.begin() + limit / 2, checkpoints.end());
+                interval *= 2;
+            }
+            checkpoints.push_back({state, machine, execution.size(), system_status.size()});
+        }
+        switch(instruction.op) {
+            case opcode_t::SYSCALL:
+            case opcode_t::END_IO:
+                note_use(device_use, instruction.operand, state.steps);
+                note_use(vector_use, instruction.operand, state.steps);
+                break;
+            case opcode_t::FORK:
+                note_use(vector_use, 2, state.steps);
+                break;
+            case opcode_t::EXEC:
+                note_use(vector_use, 3, state.steps);
+                note_use(program_use, compiled.programs[program].exec_target(instruction), state.steps);
+                break;
+            default:
+                break;
+        }
+    }
+
+    //The first instruction whose outcome the change can affect (NEVER_USED if none)
+    uint64_t first_affected(const whatif_change_t& change) const {
+        auto use = [](const std::vector<uint64_t>& uses, int number) {
+            return number >= 0 && static_cast<size_t>(number) < uses.size() ? uses[number] : NEVER_USED;
+        };
+        if(change.target == whatif_target_t::DEVICE) {
+            return use(device_use, change.number);
+        } else if(change.target == whatif_target_t::VECTOR) {
+            return use(vector_use, change.number);
+        }
+        uint64_t first = NEVER_USED;
+        for(size_t id = 0; id < compiled.programs.size(); id++) {
+            if(compiled.programs[id].program_name == change.name) {
+                first = std::min(first, use(program_use, id));
+            }
+        }
+        return first;
+    }
+
+    //The last checkpoint at or before an instruction
+    const simulation_checkpoint_t& restore_point(uint64_t step) const {
+        return checkpoints[std::min<uint64_t>(step / interval, checkpoints.size() - 1)];
+    }
+
+private:
+    static void note_use(std::vector<uint64_t>& uses, int number, uint64_t step) {
+        if(number < 0) {
+            return;
+        }
+        if(static_cast<size_t>(number) >= uses.size()) {
+            uses.resize(number + 1, NEVER_USED);
+        }
+        uses[number] = std::min(uses[number], step);
+    }
+};
+
+//Reads a change: "device <number> <delay>", "vector <number> <address>" or "program <name> <size>"
+bool parse_whatif_change(std::string_view text, whatif_change_t& change) {
+    auto words = split_delim(text, " ");
+    words.erase(std::remove(words.begin(), words.end(), ""), words.end());
+    if(words.size() != 3) {
+        return false;
+    }
+
+    auto number = [](const std::string& word, int& value) {
+        auto result = std::from_chars(word.data(), word.data() + word.size(), value);
+        return result.ec == std::errc() && result.ptr == word.data() + word.size() && value >= 0;
+    };
+    int value;
+    if(words[0] == "device") {
+        change = {whatif_target_t::DEVICE, 0, {}, words[2]};
+        return number(words[1], change.number) && number(words[2], value);
+    } else if(words[0] == "vector") {
+        change = {whatif_target_t::VECTOR, 0, {}, words[2]};
+        return number(words[1], change.number);
+    } else if(words[0] == "program") {
+        change = {whatif_target_t::PROGRAM, -1, words[1], words[2]};
+        return number(words[2], value);
+    }
+    return false;
+}
+
+//Applies a change to the tables. Returns false if it names a device or vector that is not in them.
+bool apply_whatif_change(simulation_context_t& context, const whatif_change_t& change) {
+    if(change.target == whatif_target_t::DEVICE) {
+        if(static_cast<size_t>(change.number) >= context.delays.size()) {
+            return false;
+        }
+        context.delays[change.number] = std::stoi(change.value);
+    } else if(change.target == whatif_target_t::VECTOR) {
+        std::vector<std::string> addresses = context.vectors.addresses;
+        if(static_cast<size_t>(change.number) >= addresses.size()) {
+            return false;
+        }
+        addresses[change.number] = change.value;
+        context.vectors = make_vector_table(addresses);
+    } else {
+        unsigned int size = std::stoul(change.value);
+        bool listed = false;
+        for(external_file& file : context.external_files) {
+            if(file.program_name == change.name) {
+                file.size = size;
+                listed = true;
+            }
+        }
+        if(!listed) {
+            context.external_files.push_back({change.name, size});
+        }
+        context.catalog = make_program_catalog(context.external_files);
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,567 @@
+#ifndef COMPILED_TRACE_HPP_
+#define COMPILED_TRACE_HPP_
+
+#include<iostream>
+#include<fstream>
+#include<string>
+#include<string_view>
+#include<vector>
+#include<unordered_map>
+#include<map>
+#include<deque>
+#include<algorithm>
+#include<cstdint>
+#include<cctype>
+#include<climits>
+#include<memory>
+#include<mutex>
+#include<atomic>
+
+#include "mapped_file.hpp"
+#include "profiler.hpp"
+
+//Trace activities understood by the simulator. Anything else (malformed lines,
+//unknown activities) compiles to NOP so that line indices stay the same as in
+//the text trace.
+enum class opcode_t : uint8_t {
+    NOP,
+    CPU,
+    SYSCALL,
+    END_IO,
+    FORK,
+    IF_CHILD,
+    IF_PARENT,
+    ENDIF,
+    EXEC
+};
+
+static_assert(static_cast<int>(opcode_t::EXEC) + 1 == PROFILE_OPCODES, "the profiler has a counter per opcode");
+
+//One compiled trace line: the activity, its duration/interrupt number and,
+//for EXEC, which program to run (an index into the program's exec_names).
+struct instruction_t {
+    opcode_t    op;
+    int32_t     operand;
+    uint32_t    program;
+};
+
+//One program compiled on its own. EXECs name their program by its index in
+//'exec_names', not by a trace-wide id, so the same compiled program can be
+//shared (read-only) by every trace that runs it.
+struct program_code_t {
+    std::vector<instruction_t>                  code;
+    std::vector<std::string>                    exec_names;
+    std::unordered_map<std::string, uint32_t>   exec_ids;   //!< index of each name in exec_names
+};
+
+//The (shared) code of a program with no instructions
+std::shared_ptr<const program_code_t> empty_program() {
+    static const std::shared_ptr<const program_code_t> empty = std::make_shared<const program_code_t>();
+    return empty;
+}
+
+//Read-only view of a program's instructions, wherever they are stored
+struct code_span_t {
+    const instruction_t*    data = nullptr;
+    size_t                  length = 0;
+
+    const instruction_t& operator[](size_t index) const { return data[index]; }
+    size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+    const instruction_t* begin() const { return data; }
+    const instruction_t* end() const { return data + length; }
+};
+
+struct program_image_t {
+    std::string                 program_name;
+    std::shared_ptr<const void> owner = empty_program();    //!< keeps the code alive: a program_code_t, or a mapped binary trace
+    code_span_t                 instructions;
+    std::vector<uint32_t>       exec_targets;   //!< trace-wide program id of each name the program EXECs
+
+    program_image_t() = default;
+    //A program with no code yet (see attach_program)
+    explicit program_image_t(std::string _program_name): program_name(std::move(_program_name)) {}
+
+    code_span_t code() const {
+        return instructions;
+    }
+
+    //The trace-wide program id an EXEC instruction of this program runs
+    uint32_t exec_target(const instruction_t& instruction) const {
+        return exec_targets[instruction.program];
+    }
+};
+
+#define NO_INDEX UINT32_MAX
+
+//A half-open range [begin, end) of instruction indices in one program
+struct code_range_t {
+    uint32_t    begin;
+    uint32_t    end;
+};
+
+//Position inside a view: the range it is in and the instruction index within the program
+struct view_cursor_t {
+    uint32_t    range;
+    uint32_t    index;
+};
+
+//Where a FORK sends the child and where the parent picks up again
+struct fork_branch_t {
+    uint32_t        child_view;     //!< view holding exactly the instructions the child runs
+    view_cursor_t   parent_resume;  //!< line the parent resumes after, once the child is done
+    uint32_t        endif;          //!< instruction index of the ENDIF closing the parent branch, or NO_INDEX
+};
+
+//The instructions a process runs: an ordered list of ranges of one program's code.
+//Forked children run a subsequence of their parent's view, so they are views too.
+struct trace_view_t {
+    uint32_t                                    program;
+    std::vector<code_range_t>                   ranges;
+    bool                                        resolved;   //!< 'forks' has been built
+    std::unordered_map<uint32_t, fork_branch_t> forks;      //!< keyed by the instruction index of each FORK
+};
+
+//The trace and every program reachable from it through EXEC. Program 0 is the
+//trace itself; the others are indexed by the id stored in EXEC instructions.
+//View i (for i < programs.size()) is the whole of program i and is resolved when
+//the trace is compiled; the views after those are forked children, resolved the
+//first time they run. Views live in a deque so references survive new views.
+struct compiled_trace_t {
+    std::vector<program_image_t>                programs;
+    std::unordered_map<std::string, uint32_t>   program_ids;
+    std::deque<trace_view_t>                    views;
+    std::map<std::vector<uint32_t>, uint32_t>   view_ids;
+};
+
+#define ROOT_PROGRAM 0
+
+//Returns the id of the given program, adding an (empty) image for it if it was not seen before
+uint32_t intern_program(compiled_trace_t& compiled, const std::string& program_name) {
+    auto found = compiled.program_ids.find(program_name);
+    if(found != compiled.program_ids.end()) {
+        return found->second;
+    }
+
+    uint32_t id = compiled.programs.size();
+    compiled.programs.emplace_back(program_name);
+    compiled.program_ids.emplace(program_name, id);
+    return id;
+}
+
+//Parses the leading integer of a field the same way std::stoi does
+//(leading whitespace, optional sign, then digits). Returns false if there is no number.
+bool parse_operand(std::string_view field, int32_t& value) {
+    size_t pos = 0;
+    while(pos < field.size() && std::isspace(static_cast<unsigned char>(field[pos]))) {
+        pos++;
+    }
+
+    bool negative = false;
+    if(pos < field.size() && (field[pos] == '+' || field[pos] == '-')) {
+        negative = field[pos] == '-';
+        pos++;
+    }
+
+    int64_t parsed = 0;
+    size_t first_digit = pos;
+    while(pos < field.size() && field[pos] >= '0' && field[pos] <= '9') {
+        parsed = parsed * 10 + (field[pos] - '0');
+        if(parsed > static_cast<int64_t>(INT_MAX) + 1) {
+            return false;
+        }
+        pos++;
+    }
+    if(pos == first_digit) {
+        return false;
+    }
+
+    parsed = negative ? -parsed : parsed;
+    if(parsed > INT_MAX) {
+        return false;
+    }
+
+    value = static_cast<int32_t>(parsed);
+    return true;
+}
+
+//Compiles a single trace line ("<activity>, <number>" or "EXEC <program>, <number>")
+instruction_t compile_line(std::string_view line, program_code_t& program) {
+    instruction_t instruction{opcode_t::NOP, -1, 0};
+
+    auto comma = line.find(',');
+    if(comma == std::string_view::npos) {
+        std::cerr << "Error: Malformed input line: " << line << std::endl;
+        return instruction;
+    }
+
+    //only the text between the first and the second comma is the operand
+    auto operand = line.substr(comma + 1);
+    operand = operand.substr(0, operand.find(','));
+    if(!parse_operand(operand, instruction.operand)) {
+        std::cerr << "Error: Malformed input line: " << line << std::endl;
+        instruction.operand = -1;
+        return instruction;
+    }
+
+    auto activity = line.substr(0, comma);
+    auto space = activity.find(' ');
+    if(activity.substr(0, space) == "EXEC") {
+        if(space == std::string_view::npos) {
+            std::cerr << "Error: EXEC without a program name: " << line << std::endl;
+            return instruction;
+        }
+        auto program_name = activity.substr(space + 1);
+        program_name = program_name.substr(0, program_name.find(' '));
+
+        instruction.op = opcode_t::EXEC;
+        auto [found, added] = program.exec_ids.try_emplace(std::string(program_name), program.exec_names.size());
+        if(added) {
+            program.exec_names.push_back(found->first);
+        }
+        instruction.program = found->second;
+    } else if(activity == "CPU") {
+        instruction.op = opcode_t::CPU;
+    } else if(activity == "SYSCALL") {
+        instruction.op = opcode_t::SYSCALL;
+    } else if(activity == "END_IO") {
+        instruction.op = opcode_t::END_IO;
+    } else if(activity == "FORK") {
+        instruction.op = opcode_t::FORK;
+    } else if(activity == "IF_CHILD") {
+        instruction.op = opcode_t::IF_CHILD;
+    } else if(activity == "IF_PARENT") {
+        instruction.op = opcode_t::IF_PARENT;
+    } else if(activity == "ENDIF") {
+        instruction.op = opcode_t::ENDIF;
+    }
+
+    return instruction;
+}
+
+//Compiles text, line by line (split the way std::getline splits them)
+std::shared_ptr<const program_code_t> compile_text(std::string_view text) {
+    PROFILE_SCOPE(phase_t::COMPILE);
+    auto program = std::make_shared<program_code_t>();
+    program->code.reserve(std::count(text.begin(), text.end(), '\n') + 1);
+
+    while(!text.empty()) {
+        size_t end = text.find('\n');
+        program->code.push_back(compile_line(text.substr(0, end), *program));
+        text.remove_prefix(end == std::string_view::npos ? text.size() : end + 1);
+    }
+    program->code.shrink_to_fit();
+
+    return program;
+}
+
+//Gives 'program' its compiled code and interns every program its EXECs name
+void attach_program(compiled_trace_t& compiled, uint32_t program, std::shared_ptr<const program_code_t> source) {
+    std::vector<uint32_t> exec_targets;
+    for(const auto& name : source->exec_names) {
+        exec_targets.push_back(intern_program(compiled, name));
+    }
+    //intern_program may grow compiled.programs, so only index it once we are done
+    program_image_t& image = compiled.programs[program];
+    image.instructions = {source->code.data(), source->code.size()};
+    image.owner = std::move(source);
+    image.exec_targets = std::move(exec_targets);
+}
+
+//Compiles every line of an input stream into 'program'
+void compile_stream(std::istream& input, uint32_t program, compiled_trace_t& compiled) {
+    std::string text((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+    attach_program(compiled, program, compile_text(text));
+}
+
+//Compiled programs, keyed by file name, shared by every trace compiled with the
+//same cache (e.g. all the scenarios of a batch). Each file is mapped into memory
+//and compiled once; later loads get the same read-only code. Files are assumed
+//not to change while the cache is in use. Safe to use from several threads.
+struct program_cache_t {
+    std::mutex                                                              lock;
+    std::unordered_map<std::string, std::shared_ptr<const program_code_t>>  programs;
+    std::atomic<uint64_t>                                                   hits{0};
+    std::atomic<uint64_t>                                                   misses{0};
+
+    //The compiled code of a file (no instructions if it cannot be opened)
+    std::shared_ptr<const program_code_t> load(const std::string& filename) {
+        PROFILE_SCOPE(phase_t::PROGRAM_LOAD);
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            auto found = programs.find(filename);
+            if(found != programs.end()) {
+                hits++;
+                return found->second;
+            }
+        }
+        misses++;
+
+        //compiled outside the lock; if another thread got there first, its copy wins
+        mapped_file_t file(filename);
+        std::shared_ptr<const program_code_t> program = file.is_open() ? compile_text(file.contents()) : empty_program();
+
+        std::lock_guard<std::mutex> guard(lock);
+        return programs.emplace(filename, std::move(program)).first->second;
+    }
+};
+
+//Returns the id of the view with these ranges, adding it if it was not seen before
+uint32_t intern_view(compiled_trace_t& compiled, uint32_t program, std::vector<code_range_t> ranges) {
+    std::vector<uint32_t> key;
+    key.reserve(1 + 2 * ranges.size());
+    key.push_back(program);
+    for(const auto& range : ranges) {
+        key.push_back(range.begin);
+        key.push_back(range.end);
+    }
+
+    auto found = compiled.view_ids.find(key);
+    if(found != compiled.view_ids.end()) {
+        return found->second;
+    }
+
+    uint32_t id = compiled.views.size();
+    compiled.views.push_back({program, std::move(ranges), false, {}});
+    compiled.view_ids.emplace(std::move(key), id);
+    return id;
+}
+
+//First position of a view (past any empty ranges)
+view_cursor_t view_begin(const trace_view_t& view) {
+    if(view.ranges.empty()) {
+        return {0, 0};
+    }
+    return {0, view.ranges[0].begin};
+}
+
+//Skips to the next range when the cursor ran off the current one.
+//Returns false once the cursor is past the end of the view.
+bool view_valid(const trace_view_t& view, view_cursor_t& cursor) {
+    while(cursor.range < view.ranges.size() && cursor.index >= view.ranges[cursor.range].end) {
+        cursor.range++;
+        if(cursor.range < view.ranges.size()) {
+            cursor.index = view.ranges[cursor.range].begin;
+        }
+    }
+    return cursor.range < view.ranges.size();
+}
+
+//State of the FORK child scan: whether lines are being skipped and whether the child has EXEC'd
+#define SCAN_SKIP   1
+#define SCAN_EXEC   2
+#define SCAN_STATES 4
+
+//One step of the child scan. This is the scan simulate_trace used to run from every
+//FORK, kept as is: 'skip' starts true and the child collects the lines between IF_CHILD
+//and IF_PARENT, plus the lines after ENDIF up to its first EXEC; the parent resumes
+//after the last IF_PARENT seen, or after the first one following the child's EXEC.
+struct scan_step_t {
+    uint8_t next_state;
+    bool    push;       //!< the line belongs to the child
+    bool    resume;     //!< the parent resumes after this line
+    bool    stop;       //!< the scan ends here
+    bool    endif;      //!< an ENDIF that re-enables the child
+};
+
+scan_step_t scan_step(opcode_t op, uint8_t state) {
+    bool skip = state & SCAN_SKIP;
+    scan_step_t step{state, false, false, false, false};
+
+    if(skip && op == opcode_t::IF_CHILD) {
+        step.next_state = state & ~SCAN_SKIP;
+    } else if(op == opcode_t::IF_PARENT) {
+        step.next_state = state | SCAN_SKIP;
+        step.resume = true;
+        step.stop = state & SCAN_EXEC;
+    } else if(skip && op == opcode_t::ENDIF) {
+        step.next_state = state & ~SCAN_SKIP;
+        step.endif = true;
+    } else if(!skip && op == opcode_t::EXEC) {
+        step.next_state = SCAN_SKIP | SCAN_EXEC;
+        step.push = true;
+    } else {
+        step.push = !skip;
+    }
+
+    return step;
+}
+
+/**
+ * \brief resolve every FORK of a view
+ *
+ * Runs the child scan backwards over the view once, for all four scan states at
+ * every position, so that each FORK's child, resume point and ENDIF can be read
+ * off without scanning forward from it. The children are interned as new views.
+ *
+ * @param compiled the compiled trace
+ * @param view_id the view to resolve
+ *
+ */
+void build_view_branches(compiled_trace_t& compiled, uint32_t view_id) {
+    if(compiled.views[view_id].resolved) {
+        return;
+    }
+    compiled.views[view_id].resolved = true;
+    PROFILE_SCOPE(phase_t::BRANCH_TABLES);
+
+    //flatten the view into instruction indices (positions are what the scan counts in)
+    std::vector<uint32_t> positions;
+    std::vector<uint32_t> range_of;
+    std::vector<uint32_t> range_stop;   //!< position just past each range
+    {
+        const trace_view_t& view = compiled.views[view_id];
+        for(uint32_t r = 0; r < view.ranges.size(); r++) {
+            for(uint32_t index = view.ranges[r].begin; index < view.ranges[r].end; index++) {
+                positions.push_back(index);
+                range_of.push_back(r);
+            }
+            range_stop.push_back(positions.size());
+        }
+    }
+    const uint32_t length = positions.size();
+    const uint32_t program = compiled.views[view_id].program;
+    const code_span_t code = compiled.programs[program].code();
+
+    bool has_fork = false;
+    for(uint32_t index : positions) {
+        has_fork |= code[index].op == opcode_t::FORK;
+    }
+    if(!has_fork) {
+        return;
+    }
+
+    //scan results from position p in state s, stored at [p * SCAN_STATES + s]
+    const size_t slots = (size_t(length) + 1) * SCAN_STATES;
+    std::vector<uint32_t> resume_at(slots, NO_INDEX);   //!< last resume line (NO_INDEX: none)
+    std::vector<uint32_t> endif_at(slots, NO_INDEX);    //!< first ENDIF re-enabling the child
+    std::vector<uint32_t> push_at(slots, length);       //!< first line pushed to the child
+    std::vector<uint8_t>  push_state(slots, 0);         //!< scan state at push_at
+    std::vector<uint32_t> run_end(slots, length);       //!< end of the run of pushed lines starting here
+    std::vector<uint8_t>  run_state(slots, 0);          //!< scan state at run_end
+
+    for(uint32_t p = length; p-- > 0;) {
+        opcode_t op = code[positions[p]].op;
+        for(uint8_t state = 0; state < SCAN_STATES; state++) {
+            size_t slot = size_t(p) * SCAN_STATES + state;
+            scan_step_t step = scan_step(op, state);
+            if(step.stop) {
+                resume_at[slot] = p;
+                continue;
+            }
+
+            size_t next = size_t(p + 1) * SCAN_STATES + step.next_state;
+            resume_at[slot] = resume_at[next] != NO_INDEX ? resume_at[next] : (step.resume ? p : NO_INDEX);
+            endif_at[slot]  = step.endif ? p : endif_at[next];
+
+            if(step.push) {
+                push_at[slot] = p;
+                push_state[slot] = state;
+                if(push_at[next] == p + 1) {
+                    run_end[slot] = run_end[next];
+                    run_state[slot] = run_state[next];
+                } else {
+                    run_end[slot] = p + 1;
+                    run_state[slot] = step.next_state;
+                }
+            } else {
+                push_at[slot] = push_at[next];
+                push_state[slot] = push_state[next];
+            }
+        }
+    }
+
+    for(uint32_t fork = 0; fork < length; fork++) {
+        if(code[positions[fork]].op != opcode_t::FORK) {
+            continue;
+        }
+
+        //the FORK line itself is skipped, so the scan effectively starts on the next line
+        size_t start = size_t(fork + 1) * SCAN_STATES + SCAN_SKIP;
+
+        std::vector<code_range_t> child;
+        uint32_t p = push_at[start];
+        uint8_t state = push_state[start];
+        while(p < length) {
+            size_t slot = size_t(p) * SCAN_STATES + state;
+            uint32_t end = run_end[slot];
+            //a run of positions may still span several ranges of the view
+            for(uint32_t q = p; q < end;) {
+                uint32_t stop = std::min(end, range_stop[range_of[q]]);
+                uint32_t count = stop - q;
+                if(!child.empty() && child.back().end == positions[q]) {
+                    child.back().end += count;
+                } else {
+                    child.push_back({positions[q], positions[q] + count});
+                }
+                q = stop;
+            }
+            size_t after = size_t(end) * SCAN_STATES + run_state[slot];
+            p = push_at[after];
+            state = push_state[after];
+        }
+
+        //without an IF_PARENT the parent resumes after line 0 of the view, as it always did
+        uint32_t resume = resume_at[start] == NO_INDEX ? 0 : resume_at[start];
+        uint32_t endif = endif_at[start] == NO_INDEX ? NO_INDEX : positions[endif_at[start]];
+
+        uint32_t child_view = intern_view(compiled, program, std::move(child));
+        view_cursor_t parent_resume{range_of[resume], positions[resume]};
+        compiled.views[view_id].forks.emplace(positions[fork], fork_branch_t{child_view, parent_resume, endif});
+    }
+}
+
+//Builds the view of every program and resolves its FORKs. The children's views
+//are only interned here; build_view_branches() resolves them when they first run.
+void build_branch_tables(compiled_trace_t& compiled) {
+    for(uint32_t program = 0; program < compiled.programs.size(); program++) {
+        std::vector<code_range_t> ranges;
+        if(!compiled.programs[program].code().empty()) {
+            ranges.push_back({0, static_cast<uint32_t>(compiled.programs[program].code().size())});
+        }
+        intern_view(compiled, program, std::move(ranges));
+    }
+
+    for(uint32_t program = 0; program < compiled.programs.size(); program++) {
+        build_view_branches(compiled, program);
+    }
+}
+
+/**
+ * \brief compile a trace file and every program it can reach
+ *
+ * The trace is compiled as program 0. Every program named by an EXEC is then
+ * loaded from "<program_prefix><program name>.txt" and compiled (once), until no new program
+ * names turn up. Programs whose file cannot be opened have no instructions.
+ * Finally the FORKs of every program are resolved into its branch table.
+ * Files are read through the cache, so a file compiled before (by this or an
+ * earlier call with the same cache) is not read or parsed again.
+ *
+ * @param trace_filename path to the trace file
+ * @param program_prefix put in front of every program file name: a directory ("programs/"),
+ *                       a file name prefix ("input_files/test3_") or nothing (the working directory)
+ * @param cache where compiled files are kept (nullptr: a cache for this call only)
+ * @return the compiled trace
+ *
+ */
+compiled_trace_t compile_trace(const std::string& trace_filename, const std::string& program_prefix = "", program_cache_t* cache = nullptr) {
+    program_cache_t local_cache;
+    if(cache == nullptr) {
+        cache = &local_cache;
+    }
+
+    compiled_trace_t compiled;
+    //the trace itself is not registered by name: EXEC always loads from "<program_prefix><name>.txt"
+    compiled.programs.emplace_back("init");
+    attach_program(compiled, ROOT_PROGRAM, cache->load(trace_filename));
+
+    for(uint32_t id = ROOT_PROGRAM + 1; id < compiled.programs.size(); id++) {
+        attach_program(compiled, id, cache->load(program_prefix + compiled.programs[id].program_name + ".txt"));
+    }
+
+    build_branch_tables(compiled);
+
+    return compiled;
+}
+
+#endif
@@ -0,0 +1,155 @@
+#ifndef DEVICES_HPP_
+#define DEVICES_HPP_
+
+#include<deque>
+#include<queue>
+
+#include "interrupts_101259994_101108918.hpp"
+
+#define COMPLETION_ISR_TIME 1   //!< ms the ISR of an I/O completion interrupt takes (besides the boilerplate)
+
+//How the SYSCALLs of a scheduled run are served by the devices
+enum class io_model_t {
+    IDEAL,      //!< every request is served as soon as it is made: a SYSCALL waits exactly its device's delay
+    QUEUED      //!< each device serves one request at a time, in order, and interrupts the CPU when it is done
+};
+
+//Reads an I/O model name (ideal or queued). Returns false if it is not one.
+bool parse_io_model(std::string_view name, io_model_t& model) {
+    if(name == "ideal") {
+        model = io_model_t::IDEAL;
+    } else if(name == "queued") {
+        model = io_model_t::QUEUED;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+//A request waiting for (or being served by) a device
+struct io_request_t {
+    uint32_t    process;        //!< the process that made it
+    int32_t     submitted;      //!< when the SYSCALL made it
+    int32_t     done;           //!< when the device will be done with it
+    uint64_t    sequence;       //!< the order it was made in, among the requests to every device
+};
+
+//The next completion of a busy device, on the timeline
+struct io_completion_t {
+    int32_t     time;
+    uint32_t    device;
+    uint64_t    sequence;       //!< completions at the same time come in the order their requests were made
+
+    bool operator>(const io_completion_t& other) const {
+        return time != other.time ? time > other.time : sequence > other.sequence;
+    }
+};
+
+struct device_metrics_t {
+    int         number = 0;
+    int         delay = 0;
+    uint64_t    requests = 0;
+    int64_t     busy = 0;           //!< time spent serving requests
+    int64_t     queued = 0;         //!< sum of the time requests waited for the device to be free
+    size_t      longest_queue = 0;  //!< most requests in the queue at once (the one being served included)
+};
+
+//One device: its requests, in the order it serves them
+struct io_device_t {
+    int                         delay;
+    int                         free_at = 0;    //!< when the device is done with every request in its queue
+    std::deque<io_request_t>    queue;          //!< the first is being served
+    device_metrics_t            metrics;
+};
+
+/**
+ * The devices of the device table and the timeline of their completions.
+ * A device takes its delay to serve a request and serves one at a time, in
+ * the order they were made, so the time a request will be done is known when
+ * it is made, and each device's queue is already in the order its requests
+ * will be done. The timeline (a heap) only holds the first completion of each
+ * busy device: making or completing a request is O(log devices) however many
+ * are pending, and the pending requests sit in order in their device's queue,
+ * so millions of them cost little more than the memory they take.
+ */
+struct device_bank_t {
+    std::vector<io_device_t>                                                            devices;
+    std::priority_queue<io_completion_t, std::vector<io_completion_t>, std::greater<io_completion_t>> timeline;
+    uint64_t                                                                            sequence = 0;
+    size_t                                                                              requests = 0;   //!< pending, on every device
+
+    explicit device_bank_t(const std::vector<int>& delays) {
+        devices.reserve(delays.size());
+        for(size_t number = 0; number < delays.size(); number++) {
+            devices.push_back({delays[number], 0, {}, {}});
+            devices.back().metrics.number = static_cast<int>(number);
+            devices.back().metrics.delay = delays[number];
+        }
+    }
+
+    //Queues a request on a device (a valid device number). Returns the time the device will be done with it.
+    int submit(uint32_t number, uint32_t process, int time) {
+        io_device_t& device = devices[number];
+        int start = std::max(time, device.free_at);
+        int done = start + device.delay;
+        device.free_at = done;
+        device.queue.push_back({process, time, done, sequence++});
+        requests++;
+        if(device.queue.size() == 1) {
+            timeline.push({done, number, device.queue.front().sequence});
+        }
+
+        device.metrics.requests++;
+        device.metrics.busy += device.delay;
+        device.metrics.queued += start - time;
+        device.metrics.longest_queue = std::max(device.metrics.longest_queue, device.queue.size());
+        return done;
+    }
+
+    bool pending() const {
+        return !timeline.empty();
+    }
+
+    //When the next request is done (there must be one pending)
+    int next_completion() const {
+        return timeline.top().time;
+    }
+
+    //Takes the next completion off the timeline. Returns the request and sets 'number' to its device.
+    io_request_t complete(uint32_t& number) {
+        number = timeline.top().device;
+        timeline.pop();
+        io_device_t& device = devices[number];
+        io_request_t request = device.queue.front();
+        device.queue.pop_front();
+        requests--;
+        if(!device.queue.empty()) {
+            timeline.push({device.queue.front().done, number, device.queue.front().sequence});
+        }
+        return request;
+    }
+
+    //The metrics of every device that was used
+    std::vector<device_metrics_t> used() const {
+        std::vector<device_metrics_t> metrics;
+        for(const io_device_t& device : devices) {
+            if(device.metrics.requests > 0) {
+                metrics.push_back(device.metrics);
+            }
+        }
+        return metrics;
+    }
+};
+
+//Prints how busy each device was and how long its requests waited for it
+void print_device_metrics(std::ostream& out, const std::vector<device_metrics_t>& devices, int64_t makespan) {
+    out << std::fixed << std::setprecision(1);
+    for(const device_metrics_t& device : devices) {
+        out << "  device " << device.number << " (" << device.delay << " ms): " << device.requests << " requests, busy "
+            << (makespan ? 100.0 * device.busy / makespan : 0.0) << "%, average queue wait "
+            << static_cast<double>(device.queued) / device.requests << " ms, longest queue " << device.longest_queue << std::endl;
+    }
+    out << std::defaultfloat;
+}
+
+#endif
@@ -0,0 +1,571 @@
+#ifndef EVENT_LOG_HPP_
+#define EVENT_LOG_HPP_
+
+#include<array>
+#include<deque>
+
+#include "interrupts_101259994_101108918.hpp"
+#include "compiled_trace.hpp"
+
+//Every kind of line the execution log can hold
+enum class event_kind_t : uint8_t {
+    CPU_BURST,
+    SWITCH_TO_KERNEL,
+    CONTEXT_SAVED,
+    FIND_VECTOR,        //!< vector: the interrupt number
+    LOAD_ADDRESS,       //!< vector: the interrupt number
+    SYSCALL_ISR,
+    ENDIO_ISR,
+    IRET,
+    CLONE_PCB,
+    SCHEDULER_CALLED,
+    EXEC_FAILED,        //!< value: the program (a name id in a columnar log)
+    PROGRAM_SIZE,       //!< value: the size of the program in Mb
+    LOAD_PROGRAM,
+    MARK_PARTITION,
+    UPDATE_PCB,
+    CPU_IDLE,           //!< value: the core (-1 if there is only one)
+    DISPATCH,           //!< value: the core (-1 if there is only one)
+    TERMINATED,         //!< value: the partition it freed (-1 if none)
+    PREEMPTED,
+    SYSCALL_WAIT,       //!< vector: the device, value: its delay
+    IO_DONE,            //!< vector: the device that interrupted
+    COUNT
+};
+
+enum class process_state_t {
+    READY,
+    RUNNING,
+    WAITING,
+    TERMINATED
+};
+
+const char* process_state_name(process_state_t state) {
+    switch(state) {
+        case process_state_t::READY:      return "ready";
+        case process_state_t::RUNNING:    return "running";
+        case process_state_t::WAITING:    return "waiting";
+        case process_state_t::TERMINATED: return "terminated";
+    }
+    return "unknown";
+}
+
+const char* event_kind_name(event_kind_t kind) {
+    static const char* names[] = {
+        "CPU burst", "switch to kernel mode", "context saved", "find vector", "load address", "SYSCALL ISR", "ENDIO ISR",
+        "IRET", "cloning the PCB", "scheduler called", "EXEC failed", "program size", "loading program", "marking partition",
+        "updating PCB", "CPU idle", "dispatch", "terminated", "quantum expired", "SYSCALL wait", "I/O done"};
+    static_assert(sizeof(names) / sizeof(names[0]) == static_cast<size_t>(event_kind_t::COUNT), "a name per event kind");
+    return kind < event_kind_t::COUNT ? names[static_cast<size_t>(kind)] : "unknown";
+}
+
+//One line of the execution log, as data
+struct event_t {
+    int32_t         time;
+    int32_t         duration;
+    event_kind_t    kind;
+    int32_t         pid;        //!< the running process
+    int32_t         vector;     //!< interrupt or device number (-1 if none)
+    int32_t         partition;  //!< the running process' partition
+    int32_t         value;      //!< depends on the kind (-1 if none)
+};
+
+/**
+ * Where the simulator reports what happens: one event per line of the execution
+ * log, and snapshots of the processes for the system status log. A snapshot is
+ * begun, given one row per process, then ended. Logs decide how (and whether) to
+ * store them; text_event_log_t writes the usual text files.
+ */
+struct event_log_t {
+    virtual ~event_log_t() = default;
+
+    //'program' is the program named by an EXEC_FAILED event, empty for the others
+    virtual void event(const event_t& event, std::string_view program = {}) = 0;
+    //'program' is the program an EXEC loaded, empty for a FORK
+    virtual void snapshot(int time, opcode_t trace, int operand, std::string_view program) = 0;
+    virtual void snapshot_row(int pid, std::string_view program, int partition, unsigned int size, process_state_t state) = 0;
+    virtual void snapshot_end() = 0;
+
+    //Whether the log keeps the process table from one snapshot to the next, and so
+    //can be given a snapshot as the rows that changed (see snapshot_changes)
+    virtual bool keeps_table() const {
+        return false;
+    }
+    //Begins a snapshot given as the rows that changed since the snapshot before, for
+    //a log that keeps the table: a row for every process that is new or changed and
+    //a TERMINATED row for every process that ended, in the order of the table (new
+    //processes after the others), then snapshot_end
+    virtual void snapshot_changes(int time, opcode_t trace, int operand, std::string_view program) {
+        snapshot(time, trace, operand, program);
+    }
+
+    //Logs an event of the running process
+    void emit(event_kind_t kind, int time, int duration, const PCB& current, int vector = -1, int value = -1, std::string_view program = {}) {
+        PROFILE_SIM_EVENT(event_kind_name(kind), current.PID, time, duration);
+        event({time, duration, kind, static_cast<int32_t>(current.PID), vector, current.partition_number, value}, program);
+    }
+
+    //Logs time with no process running (on a given core, if there are several)
+    void idle(int time, int duration, int core = -1) {
+        PROFILE_SIM_EVENT(event_kind_name(event_kind_t::CPU_IDLE), -1, time, duration);
+        event({time, duration, event_kind_t::CPU_IDLE, -1, -1, -1, core});
+    }
+
+    void snapshot_row(const PCB& pcb, process_state_t state) {
+        snapshot_row(pcb.PID, pcb.program_name, pcb.partition_number, pcb.size, state);
+    }
+};
+
+//Default interrupt boilerplate. Logs the steps and returns the time after them.
+int intr_boilerplate(event_log_t& log, int current_time, int intr_num, int context_save_time, const PCB& current) {
+
+    log.emit(event_kind_t::SWITCH_TO_KERNEL, current_time, 1, current);
+    current_time++;
+
+    log.emit(event_kind_t::CONTEXT_SAVED, current_time, context_save_time, current);
+    current_time += context_save_time;
+
+    log.emit(event_kind_t::FIND_VECTOR, current_time, 1, current, intr_num);
+    current_time++;
+
+    log.emit(event_kind_t::LOAD_ADDRESS, current_time, 1, current, intr_num);
+    current_time++;
+
+    return current_time;
+}
+
+//Writes an event as a line of execution.txt
+void render_event(output_sink_t& execution, const event_t& event, std::string_view program, const vector_table_t& vectors) {
+    execution.print(event.time, ", ", event.duration, ", ");
+    switch(event.kind) {
+        case event_kind_t::CPU_BURST:           execution.write("CPU Burst\n"); break;
+        case event_kind_t::SWITCH_TO_KERNEL:    execution.write("switch to kernel mode\n"); break;
+        case event_kind_t::CONTEXT_SAVED:       execution.write("context saved\n"); break;
+        case event_kind_t::FIND_VECTOR:         execution.print(vectors.find_vector.at(event.vector), "\n"); break;
+        case event_kind_t::LOAD_ADDRESS:        execution.print(vectors.load_address.at(event.vector), "\n"); break;
+        case event_kind_t::SYSCALL_ISR:         execution.write("SYSCALL ISR (ADD STEPS HERE)\n"); break;
+        case event_kind_t::ENDIO_ISR:           execution.write("ENDIO ISR(ADD STEPS HERE)\n"); break;
+        case event_kind_t::IRET:                execution.write("IRET\n"); break;
+        case event_kind_t::CLONE_PCB:           execution.write("cloning the PCB\n"); break;
+        case event_kind_t::SCHEDULER_CALLED:    execution.write("scheduler called\n"); break;
+        case event_kind_t::EXEC_FAILED:         execution.print("EXEC failed: ", program, " not found\n"); break;
+        case event_kind_t::PROGRAM_SIZE:        execution.print("Program is ", event.value, " Mb large\n"); break;
+        case event_kind_t::LOAD_PROGRAM:        execution.write("loading program into memory\n"); break;
+        case event_kind_t::MARK_PARTITION:      execution.write("marking partition as occupied\n"); break;
+        case event_kind_t::UPDATE_PCB:          execution.write("updating PCB\n"); break;
+        case event_kind_t::CPU_IDLE:
+            if(event.value < 0) {
+                execution.write("CPU idle\n");
+            } else {
+                execution.print("core ", event.value, " idle\n");
+            }
+            break;
+        case event_kind_t::DISPATCH:
+            if(event.value < 0) {
+                execution.print("scheduler called: dispatch PID ", event.pid, "\n");
+            } else {
+                execution.print("scheduler called: dispatch PID ", event.pid, " on core ", event.value, "\n");
+            }
+            break;
+        case event_kind_t::TERMINATED:
+            if(event.value < 0) {
+                execution.print("PID ", event.pid, " terminated\n");
+            } else {
+                execution.print("PID ", event.pid, " terminated, partition ", event.value, " freed\n");
+            }
+            break;
+        case event_kind_t::PREEMPTED:           execution.print("quantum expired: PID ", event.pid, " preempted\n"); break;
+        case event_kind_t::SYSCALL_WAIT:
+            execution.print("SYSCALL ISR: PID ", event.pid, " waits ", event.value, " ms for device ", event.vector, "\n");
+            break;
+        case event_kind_t::IO_DONE:
+            execution.print("ENDIO ISR: device ", event.vector, " done, PID ", event.pid, " ready\n");
+            break;
+        case event_kind_t::COUNT:               execution.write("unknown event\n"); break;
+    }
+}
+
+//Writes the logs as text: execution.txt and system_status.txt
+struct text_event_log_t : event_log_t {
+    output_sink_t&          execution;
+    output_sink_t&          system_status;
+    const vector_table_t&   vectors;
+
+    text_event_log_t(output_sink_t& _execution, output_sink_t& _system_status, const vector_table_t& _vectors):
+        execution(_execution), system_status(_system_status), vectors(_vectors) {}
+
+    void event(const event_t& event, std::string_view program = {}) override {
+        PROFILE_SCOPE(phase_t::LOG);
+        render_event(execution, event, program, vectors);
+    }
+
+    void snapshot(int time, opcode_t trace, int operand, std::string_view program) override {
+        PROFILE_SCOPE(phase_t::LOG);
+        if(trace == opcode_t::EXEC) {
+            system_status.print("time: ", time, "; current trace: EXEC ", program, ", ", operand, "\n");
+        } else {
+            system_status.print("time: ", time, "; current trace: FORK, ", operand, "\n");
+        }
+        system_status.write("+------------------------------------------------------+\n");
+        system_status.write("| PID |program name |partition number | size | state |\n");
+        system_status.write("+------------------------------------------------------+\n");
+    }
+
+    void snapshot_row(int pid, std::string_view program, int partition, unsigned int size, process_state_t state) override {
+        PROFILE_SCOPE(phase_t::LOG);
+        system_status.print("| ", pid, " | ", program, " | ", partition, " | ", size, " | ", process_state_name(state), " |\n");
+    }
+    using event_log_t::snapshot_row;
+
+    void snapshot_end() override {
+        system_status.write("+------------------------------------------------------+\n");
+    }
+};
+
+//Sends everything to two logs
+struct tee_event_log_t : event_log_t {
+    event_log_t& first;
+    event_log_t& second;
+
+    tee_event_log_t(event_log_t& _first, event_log_t& _second): first(_first), second(_second) {}
+
+    void event(const event_t& event, std::string_view program = {}) override {
+        first.event(event, program);
+        second.event(event, program);
+    }
+
+    void snapshot(int time, opcode_t trace, int operand, std::string_view program) override {
+        first.snapshot(time, trace, operand, program);
+        second.snapshot(time, trace, operand, program);
+    }
+
+    void snapshot_row(int pid, std::string_view program, int partition, unsigned int size, process_state_t state) override {
+        first.snapshot_row(pid, program, partition, size, state);
+        second.snapshot_row(pid, program, partition, size, state);
+    }
+    using event_log_t::snapshot_row;
+
+    void snapshot_end() override {
+        first.snapshot_end();
+        second.snapshot_end();
+    }
+};
+
+//A columnar log file (see columnar_event_log_t). Everything is stored in the byte
+//order of the machine that wrote it, as a header followed by chunks, each a tag
+//and a count followed by its payload (padded to 4 bytes):
+//
+//  EVENT_CHUNK_NAMES   count names, each a uint32 length and the bytes. Name ids
+//                      count up from 0 across chunks; a name is always defined
+//                      before the first chunk that uses it.
+//  EVENT_CHUNK_EVENTS  count events, column by column: time, duration, pid, vector,
+//                      partition and value (int32 each), then kind (uint8)
+//  EVENT_CHUNK_STATUS  count status_record_t
+//  EVENT_CHUNK_END     the end of the log (count 0)
+#define EVENT_LOG_MAGIC         "SIMLOG\0\0"
+#define EVENT_LOG_VERSION       1
+#define EVENT_LOG_BYTE_ORDER    0x01020304u
+#define EVENT_BLOCK_SIZE        4096    //!< events per EVENT_CHUNK_EVENTS
+#define STATUS_BLOCK_SIZE       1024    //!< records per EVENT_CHUNK_STATUS
+
+enum event_chunk_t : uint32_t {
+    EVENT_CHUNK_END,
+    EVENT_CHUNK_NAMES,
+    EVENT_CHUNK_EVENTS,
+    EVENT_CHUNK_STATUS
+};
+
+struct event_log_header_t {
+    char        magic[8];
+    uint32_t    byte_order;
+    uint32_t    version;
+};
+
+//A system status snapshot (STATUS_SNAPSHOT) followed by its rows (STATUS_ROW)
+#define STATUS_SNAPSHOT 1
+#define STATUS_ROW      2
+
+struct status_record_t {
+    uint8_t     tag;
+    uint8_t     code;       //!< snapshot: opcode of the trace line; row: process_state_t
+    uint16_t    reserved;
+    int32_t     first;      //!< snapshot: time; row: PID
+    int32_t     second;     //!< snapshot: trace operand; row: partition
+    uint32_t    program;    //!< name id of the program (snapshot: the EXEC'd program, NO_INDEX for a FORK)
+    uint32_t    size;       //!< row: the size of the program (0 for a snapshot)
+};
+
+static_assert(sizeof(event_log_header_t) == 16 && sizeof(status_record_t) == 20, "unexpected event log record size");
+
+//Event columns, in file order
+#define EVENT_INT_COLUMNS 6
+
+/**
+ * Writes the logs as columns of fixed-width values (see EVENT_LOG_MAGIC), to be
+ * read by analysis tools without parsing text. Events are collected in blocks of
+ * EVENT_BLOCK_SIZE and written column by column; snapshots are compact records.
+ * Program names are stored once, in a string table. Call finish() once the run is
+ * done: the log is not complete before.
+ */
+struct columnar_event_log_t : event_log_t {
+    output_sink_t&                                      output;
+    std::array<std::vector<int32_t>, EVENT_INT_COLUMNS> columns;    //!< time, duration, pid, vector, partition, value
+    std::vector<uint8_t>                                kinds;
+    size_t                                              events = 0; //!< events in the current block
+    std::vector<status_record_t>                        status;
+    size_t                                              records = 0;
+    std::deque<std::string>                             names;      //!< by id (a deque, so the keys below stay valid)
+    std::unordered_map<std::string_view, uint32_t>      name_ids;
+    size_t                                              names_written = 0;
+    bool                                                finished = false;
+
+    explicit columnar_event_log_t(output_sink_t& _output): output(_output), kinds(EVENT_BLOCK_SIZE), status(STATUS_BLOCK_SIZE) {
+        for(auto& column : columns) {
+            column.resize(EVENT_BLOCK_SIZE);
+        }
+        event_log_header_t header{};
+        std::memcpy(header.magic, EVENT_LOG_MAGIC, sizeof(header.magic));
+        header.byte_order = EVENT_LOG_BYTE_ORDER;
+        header.version = EVENT_LOG_VERSION;
+        write_bytes(&header, sizeof(header));
+    }
+
+    ~columnar_event_log_t() override {
+        finish();
+    }
+
+    void event(const event_t& event, std::string_view program = {}) override {
+        PROFILE_SCOPE(phase_t::LOG);
+        if(events == EVENT_BLOCK_SIZE) {
+            flush_blocks();
+        }
+        int32_t value = event.kind == event_kind_t::EXEC_FAILED ? static_cast<int32_t>(intern(program)) : event.value;
+        columns[0][events] = event.time;
+        columns[1][events] = event.duration;
+        columns[2][events] = event.pid;
+        columns[3][events] = event.vector;
+        columns[4][events] = event.partition;
+        columns[5][events] = value;
+        kinds[events] = static_cast<uint8_t>(event.kind);
+        events++;
+    }
+
+    void snapshot(int time, opcode_t trace, int operand, std::string_view program) override {
+        uint32_t name = trace == opcode_t::EXEC ? intern(program) : NO_INDEX;
+        add_record({STATUS_SNAPSHOT, static_cast<uint8_t>(trace), 0, time, operand, name, 0});
+    }
+
+    void snapshot_row(int pid, std::string_view program, int partition, unsigned int size, process_state_t state) override {
+        add_record({STATUS_ROW, static_cast<uint8_t>(state), 0, pid, partition, intern(program), size});
+    }
+    using event_log_t::snapshot_row;
+
+    void snapshot_end() override {}
+
+    //Writes what is left and the end of the log
+    void finish() {
+        if(!finished) {
+            finished = true;
+            flush_blocks();
+            write_chunk(EVENT_CHUNK_END, 0);
+            output.flush();
+        }
+    }
+
+private:
+    uint32_t intern(std::string_view name) {
+        auto found = name_ids.find(name);
+        if(found != name_ids.end()) {
+            return found->second;
+        }
+        uint32_t id = names.size();
+        names.emplace_back(name);
+        name_ids.emplace(names.back(), id);
+        return id;
+    }
+
+    void add_record(const status_record_t& record) {
+        PROFILE_SCOPE(phase_t::LOG);
+        if(records == STATUS_BLOCK_SIZE) {
+            flush_blocks();
+        }
+        status[records++] = record;
+    }
+
+    void write_bytes(const void* data, size_t size) {
+        output.write(std::string_view(static_cast<const char*>(data), size));
+    }
+
+    void pad(size_t size) {
+        static const char zeros[4] = {};
+        write_bytes(zeros, (4 - size % 4) % 4);
+    }
+
+    void write_chunk(uint32_t tag, uint32_t count) {
+        write_bytes(&tag, sizeof(tag));
+        write_bytes(&count, sizeof(count));
+    }
+
+    //Writes the new names, then the buffered events and status records
+    void flush_blocks() {
+        if(names_written < names.size()) {
+            write_chunk(EVENT_CHUNK_NAMES, names.size() - names_written);
+            for(; names_written < names.size(); names_written++) {
+                const std::string& name = names[names_written];
+                uint32_t length = name.size();
+                write_bytes(&length, sizeof(length));
+                write_bytes(name.data(), length);
+                pad(length);
+            }
+        }
+        if(events > 0) {
+            write_chunk(EVENT_CHUNK_EVENTS, events);
+            for(const auto& column : columns) {
+                write_bytes(column.data(), events * sizeof(int32_t));
+            }
+            write_bytes(kinds.data(), events);
+            pad(events);
+            events = 0;
+        }
+        if(records > 0) {
+            write_chunk(EVENT_CHUNK_STATUS, records);
+            write_bytes(status.data(), records * sizeof(status_record_t));
+            records = 0;
+        }
+    }
+};
+
+/**
+ * \brief replay a columnar log
+ *
+ * Reads the events and snapshots of a log written by columnar_event_log_t and
+ * sends them, in order, to another log: replaying into a text_event_log_t renders
+ * the same execution.txt and system_status.txt the run would have written.
+ *
+ * @param contents the whole log (e.g. a mapped file's contents)
+ * @param log where the events and snapshots go
+ * @param error why the log could not be read
+ * @return false if the log is not a valid columnar log (what came before the problem has been replayed)
+ *
+ */
+bool replay_event_log(std::string_view contents, event_log_t& log, std::string& error) {
+    const char* data = contents.data();
+    size_t size = contents.size();
+    size_t offset = sizeof(event_log_header_t);
+
+    event_log_header_t header;
+    if(size < sizeof(header)) {
+        error = "truncated header";
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if(std::memcmp(header.magic, EVENT_LOG_MAGIC, sizeof(header.magic)) != 0) {
+        error = "not a columnar event log";
+        return false;
+    }
+    if(header.byte_order != EVENT_LOG_BYTE_ORDER || header.version != EVENT_LOG_VERSION) {
+        error = "unsupported byte order or version";
+        return false;
+    }
+
+    auto read_u32 = [&](uint32_t& value) {
+        if(size - offset < sizeof(value)) {
+            return false;
+        }
+        std::memcpy(&value, data + offset, sizeof(value));
+        offset += sizeof(value);
+        return true;
+    };
+    auto padded = [](uint64_t length) { return (length + 3) & ~uint64_t(3); };
+
+    std::vector<std::string_view> names;
+    auto name_of = [&](uint32_t id, std::string_view& name) {
+        if(id >= names.size()) {
+            return false;
+        }
+        name = names[id];
+        return true;
+    };
+    bool in_snapshot = false;
+
+    while(true) {
+        uint32_t tag, count;
+        if(!read_u32(tag) || !read_u32(count)) {
+            error = "truncated chunk";
+            return false;
+        }
+
+        if(tag == EVENT_CHUNK_END) {
+            break;
+        } else if(tag == EVENT_CHUNK_NAMES) {
+            for(uint32_t i = 0; i < count; i++) {
+                uint32_t length;
+                if(!read_u32(length) || size - offset < padded(length)) {
+                    error = "truncated name";
+                    return false;
+                }
+                names.emplace_back(data + offset, length);
+                offset += padded(length);
+            }
+        } else if(tag == EVENT_CHUNK_EVENTS) {
+            uint64_t bytes = uint64_t(count) * (EVENT_INT_COLUMNS * sizeof(int32_t)) + padded(count);
+            if(size - offset < bytes) {
+                error = "truncated events";
+                return false;
+            }
+            const char* block = data + offset;
+            auto column = [&](int c, uint32_t i) {
+                int32_t value;
+                std::memcpy(&value, block + (uint64_t(c) * count + i) * sizeof(int32_t), sizeof(value));
+                return value;
+            };
+            const uint8_t* kinds = reinterpret_cast<const uint8_t*>(block + uint64_t(count) * EVENT_INT_COLUMNS * sizeof(int32_t));
+            for(uint32_t i = 0; i < count; i++) {
+                event_t event{column(0, i), column(1, i), static_cast<event_kind_t>(kinds[i]), column(2, i), column(3, i), column(4, i), column(5, i)};
+                std::string_view program;
+                if(kinds[i] >= static_cast<uint8_t>(event_kind_t::COUNT)
+                   || (event.kind == event_kind_t::EXEC_FAILED && !name_of(event.value, program))) {
+                    error = "bad event";
+                    return false;
+                }
+                log.event(event, program);
+            }
+            offset += bytes;
+        } else if(tag == EVENT_CHUNK_STATUS) {
+            if((size - offset) / sizeof(status_record_t) < count) {
+                error = "truncated status records";
+                return false;
+            }
+            for(uint32_t i = 0; i < count; i++) {
+                status_record_t record;
+                std::memcpy(&record, data + offset, sizeof(record));
+                offset += sizeof(record);
+
+                std::string_view program;
+                if(record.tag == STATUS_SNAPSHOT && (record.program == NO_INDEX || name_of(record.program, program))) {
+                    if(in_snapshot) {
+                        log.snapshot_end();
+                    }
+                    log.snapshot(record.first, static_cast<opcode_t>(record.code), record.second, program);
+                    in_snapshot = true;
+                } else if(record.tag == STATUS_ROW && in_snapshot && record.code <= static_cast<uint8_t>(process_state_t::TERMINATED)
+                          && name_of(record.program, program)) {
+                    log.snapshot_row(record.first, program, record.second, record.size, static_cast<process_state_t>(record.code));
+                } else {
+                    error = "bad status record";
+                    return false;
+                }
+            }
+        } else {
+            error = "unknown chunk " + std::to_string(tag);
+            return false;
+        }
+    }
+    if(in_snapshot) {
+        log.snapshot_end();
+    }
+
+    return true;
+}
+
+#endif
@@ -4,34 +4,28 @@
 #include<iostream>
 #include<fstream>
 #include<string>
+#include<string_view>
 #include<vector>
+#include<unordered_map>
+#include<memory>
 #include<random>
 #include<utility>
+#include<tuple>
+#include<stdexcept>
 #include<sstream>
 #include<iomanip>
 #include <algorithm>
 #include<stdio.h>
 
+#include "output_sink.hpp"
+#include "memory_allocator.hpp"
+#include "profiler.hpp"
+
 #define ADDR_BASE   0
 #define VECTOR_SIZE 2
 
-struct memory_partition_t {
-    const unsigned int partition_number;
-    const unsigned int size;
-    std::string code;
-
-    memory_partition_t(unsigned int _pn, unsigned int _s, std::string _c):
-        partition_number(_pn), size(_s), code(_c) {}
-};
-
-memory_partition_t memory[] = {
-    memory_partition_t(1, 40, "empty"),
-    memory_partition_t(2, 25, "empty"),
-    memory_partition_t(3, 15, "empty"),
-    memory_partition_t(4, 10, "empty"),
-    memory_partition_t(5, 8, "empty"),
-    memory_partition_t(6, 2, "empty")
-};
+//Sizes (in Mb) of the fixed memory partitions, partition 1 first
+const std::vector<unsigned int> default_partition_sizes = {40, 25, 15, 10, 8, 2};
 
 struct PCB{
     unsigned int    PID;
@@ -41,78 +35,96 @@ struct PCB{
     int             partition_number;
 
     PCB(unsigned int _pid, int _ppid, std::string _pn, unsigned int _size, int _part_num):
-        PID(_pid), PPID(_ppid), program_name(_pn), size(_size), partition_number(_part_num) {}
+        PID(_pid), PPID(_ppid), program_name(std::move(_pn)), size(_size), partition_number(_part_num) {}
 };
 
 struct external_file{
     std::string     program_name;
     unsigned int    size;
+    int             priority = 0;   //!< optional third column; lower runs first under --scheduler=priority
+};
+
+//The state a simulation changes as it runs: its memory and its PID counter. Every
+//run gets its own machine, so simulations in the same process (one after the
+//other or side by side) never see each other's partitions or PIDs.
+struct machine_t {
+    std::unique_ptr<memory_allocator_t> memory;         //!< the partitions and the policy that hands them out
+    unsigned int                        next_pid = 1;   //!< PID of the next process a FORK creates
+
+    explicit machine_t(allocation_policy_t policy = allocation_policy_t::BEST_FIT, const std::vector<unsigned int>& partition_sizes = default_partition_sizes):
+        memory(make_memory_allocator(policy, partition_sizes)) {}
+
+    //Copies are independent machines in the same state
+    machine_t(const machine_t& other): memory(other.memory->clone()), next_pid(other.next_pid) {}
+    machine_t(machine_t&&) = default;
+
+    machine_t& operator=(const machine_t& other) {
+        if(this != &other) {
+            memory = other.memory->clone();
+            next_pid = other.next_pid;
+        }
+        return *this;
+    }
+    machine_t& operator=(machine_t&&) = default;
 };
 
 //Allocates a program to memory (if there is space)
 //returns true if the allocation was sucessful, false if not.
-bool allocate_memory(PCB* current) {
-    for(int i = 5; i >= 0; i--) { //Start from smallest partition
-        //check is the code will fit and if the partition is empty
-        if(memory[i].size >= current->size && memory[i].code == "empty") {
-            current->partition_number = memory[i].partition_number;
-            memory[i].code = current->program_name;
-            return true;
-        }
+bool allocate_memory(machine_t& machine, PCB* current) {
+    PROFILE_SCOPE(phase_t::ALLOCATE);
+    int partition_number = machine.memory->allocate(current->size, current->PID);
+    if(partition_number < 0) {
+        return false;
     }
-    return false;
+    current->partition_number = partition_number;
+    return true;
 }
 
 //frees the memory given PCB.
-void free_memory(PCB* process) {
-    memory[process->partition_number - 1].code = "empty";
+void free_memory(machine_t& machine, PCB* process) {
+    PROFILE_SCOPE(phase_t::FREE);
+    machine.memory->release(process->partition_number);
     process->partition_number = -1;
 }
 
-// Following function was taken from stackoverflow; helper function for splitting strings
-std::vector<std::string> split_delim(std::string input, std::string delim) {
+// Following function was adapted from stackoverflow; helper function for splitting strings
+std::vector<std::string> split_delim(std::string_view input, std::string_view delim) {
     std::vector<std::string> tokens;
     std::size_t pos = 0;
-    std::string token;
-    while ((pos = input.find(delim)) != std::string::npos) {
-        token = input.substr(0, pos);
-        tokens.push_back(token);
-        input.erase(0, pos + delim.length());
+    while ((pos = input.find(delim)) != std::string_view::npos) {
+        tokens.emplace_back(input.substr(0, pos));
+        input.remove_prefix(pos + delim.length());
     }
-    tokens.push_back(input);
+    tokens.emplace_back(input);
 
     return tokens;
 }
 
 /**
- * \brief parse the CLI arguments
+ * \brief read the input tables
  *
- * This helper function parses command line arguments and checks for errors 
- * 
- * @param argc number of command line arguments
- * @param argv the command line arguments
+ * Reads the vector table, the device table and the external files table, and
+ * checks that the trace file can be opened.
+ *
+ * @param trace path to the trace file
+ * @param vector_table path to the vector table
+ * @param device_table path to the device table
+ * @param external_files_table path to the external files table
  * @return a vector of strings (the parsed vector table), a vector of delays, a vector of external files
- * 
+ * @throws std::runtime_error if a file cannot be opened
+ *
  */
-std::tuple<std::vector<std::string>, std::vector<int>, std::vector<external_file>>parse_args(int argc, char** argv) {
-    if(argc != 5) {
-        std::cout << "ERROR!\nExpected 4 argument, received " << argc - 1 << std::endl;
-        std::cout << "To run the program, do: ./interrutps <your_trace_file.txt> <your_vector_table.txt> <your_device_table.txt> <your_external_files.txt>" << std::endl;
-        exit(1);
-    }
-
+std::tuple<std::vector<std::string>, std::vector<int>, std::vector<external_file>> load_tables(const std::string& trace, const std::string& vector_table, const std::string& device_table, const std::string& external_files_table) {
     std::ifstream input_file;
-    input_file.open(argv[1]);
+    input_file.open(trace);
     if (!input_file.is_open()) {
-        std::cerr << "Error: Unable to open file: " << argv[1] << std::endl;
-        exit(1);
+        throw std::runtime_error("Unable to open file: " + trace);
     }
     input_file.close();
 
-    input_file.open(argv[2]);
+    input_file.open(vector_table);
     if (!input_file.is_open()) {
-        std::cerr << "Error: Unable to open file: " << argv[2] << std::endl;
-        exit(1);
+        throw std::runtime_error("Unable to open file: " + vector_table);
     }
 
     std::string vector;
@@ -124,11 +136,10 @@ std::tuple<std::vector<std::string>, std::vector<int>, std::vector<external_file
 
     std::string duration;
     std::vector<int> delays;
-    input_file.open(argv[3]);
+    input_file.open(device_table);
 
     if (!input_file.is_open()) {
-        std::cerr << "Error: Unable to open file: " << argv[3] << std::endl;
-        exit(1);
+        throw std::runtime_error("Unable to open file: " + device_table);
     }
 
     while(std::getline(input_file, duration)) {
@@ -137,30 +148,62 @@ std::tuple<std::vector<std::string>, std::vector<int>, std::vector<external_file
     input_file.close();
 
     std::vector<external_file> external_files;
-    input_file.open(argv[4]);
+    input_file.open(external_files_table);
     if (!input_file.is_open()) {
-        std::cerr << "Error: Unable to open file: " << argv[4] << std::endl;
-        exit(1);
+        throw std::runtime_error("Unable to open file: " + external_files_table);
     }
 
     std::string file_content;
+    int line = 0;
     while(std::getline(input_file, file_content)) {
+        line++;
         external_file entry;
         auto file_info      = split_delim(file_content, ",");
+        if(file_info.size() < 2) {
+            throw std::runtime_error("Invalid external file '" + file_content + "' on line " + std::to_string(line) + " of " + external_files_table);
+        }
 
         entry.program_name  = file_info[0];
         entry.size          = std::stoi(file_info[1]);
-        external_files.push_back(entry);
+        if(file_info.size() > 2) {
+            entry.priority  = std::stoi(file_info[2]);
+        }
+        external_files.push_back(std::move(entry));
     }
 
     input_file.close();
 
 
-    return {vectors, delays, external_files};
+    return {std::move(vectors), std::move(delays), std::move(external_files)};
+}
+
+/**
+ * \brief parse the CLI arguments
+ *
+ * This helper function parses command line arguments and checks for errors 
+ * 
+ * @param argc number of command line arguments
+ * @param argv the command line arguments
+ * @return a vector of strings (the parsed vector table), a vector of delays, a vector of external files
+ * 
+ */
+std::tuple<std::vector<std::string>, std::vector<int>, std::vector<external_file>>parse_args(int argc, char** argv) {
+    if(argc < 5) {
+        std::cout << "ERROR!\nExpected 4 argument, received " << argc - 1 << std::endl;
+        std::cout << "To run the program, do: ./interrutps <your_trace_file.txt> <your_vector_table.txt> <your_device_table.txt> <your_external_files.txt> [options]" << std::endl;
+        exit(1);
+    }
+
+    try {
+        return load_tables(argv[1], argv[2], argv[3], argv[4]);
+    } catch(const std::runtime_error& error) {
+        std::cerr << "Error: " << error.what() << std::endl;
+        exit(1);
+    }
 }
 
 //Parces each trace and returns a tuple: {Tace activity, duration or interrupt number, program name (if applicable)}
-std::tuple<std::string, int, std::string> parse_trace(std::string trace) {
+std::tuple<std::string, int, std::string> parse_trace(std::string_view trace) {
     //split line by ','
     auto parts = split_delim(trace, ",");
     if (parts.size() < 2) {
@@ -181,33 +224,77 @@ std::tuple<std::string, int, std::string> parse_trace(std::string trace) {
     return {activity, duration_intr, extern_file};
 }
 
-//Default interrupt boilerplate
-std::pair<std::string, int> intr_boilerplate(int current_time, int intr_num, int context_save_time, std::vector<std::string> vectors) {
+//The vector table, with the log text of every entry formatted once (at startup)
+struct vector_table_t {
+    std::vector<std::string> addresses;     //!< ISR addresses, as read from the vector table file
+    std::vector<std::string> find_vector;   //!< "find vector <n> in memory position 0x<position>"
+    std::vector<std::string> load_address;  //!< "load address <address> into the PC"
+};
 
-    std::string execution = "";
+vector_table_t make_vector_table(const std::vector<std::string>& vectors) {
+    vector_table_t table;
 
-    execution += std::to_string(current_time) + ", " + std::to_string(1) + ", switch to kernel mode\n";
-    current_time++;
+    for(size_t intr_num = 0; intr_num < vectors.size(); intr_num++) {
+        char vector_address_c[10];
+        sprintf(vector_address_c, "0x%04X", (unsigned int)(ADDR_BASE + (intr_num * VECTOR_SIZE)));
+        std::string vector_address(vector_address_c);
 
-    execution += std::to_string(current_time) + ", " + std::to_string(context_save_time) + ", context saved\n";
-    current_time += context_save_time;
-    
-    char vector_address_c[10];
-    sprintf(vector_address_c, "0x%04X", (ADDR_BASE + (intr_num * VECTOR_SIZE)));
-    std::string vector_address(vector_address_c);
+        table.find_vector.push_back("find vector " + std::to_string(intr_num) + " in memory position " + vector_address);
+        table.load_address.push_back("load address " + vectors[intr_num] + " into the PC");
+    }
+    table.addresses = vectors;
+
+    return table;
+}
+
+//The external files table, hashed by program name
+struct program_catalog_t {
+    std::unordered_map<std::string, unsigned int> sizes;
+    std::unordered_map<std::string, int> priorities;
+};
 
-    execution += std::to_string(current_time) + ", " + std::to_string(1) + ", find vector " + std::to_string(intr_num) 
-                    + " in memory position " + vector_address + "\n";
-    current_time++;
+//Builds the catalog from the external files table. As with a linear search,
+//the first entry wins if a program is listed twice.
+program_catalog_t make_program_catalog(const std::vector<external_file>& external_files) {
+    program_catalog_t catalog;
+    catalog.sizes.reserve(external_files.size());
+    catalog.priorities.reserve(external_files.size());
 
-    execution += std::to_string(current_time) + ", " + std::to_string(1) + ", load address " + vectors.at(intr_num) + " into the PC\n";
-    current_time++;
+    for(const auto& file : external_files) {
+        catalog.sizes.emplace(file.program_name, file.size);
+        catalog.priorities.emplace(file.program_name, file.priority);
+    }
+
+    return catalog;
+}
+
+//Looks a program up in the catalog. Returns false if the program is not listed.
+bool find_program(const program_catalog_t& catalog, const std::string& name, unsigned int& size) {
+    auto found = catalog.sizes.find(name);
+    if(found == catalog.sizes.end()) {
+        return false;
+    }
+    size = found->second;
+    return true;
+}
 
-    return std::make_pair(execution, current_time);
+//Priority of a program (0 if it is not listed)
+int program_priority(const program_catalog_t& catalog, const std::string& name) {
+    auto found = catalog.priorities.find(name);
+    return found == catalog.priorities.end() ? 0 : found->second;
 }
 
+//The tables a simulation reads but never changes. Built once and shared, by
+//reference, with everything that runs during the simulation.
+struct simulation_context_t {
+    vector_table_t              vectors;        //!< the vector table (ISR addresses)
+    std::vector<int>            delays;         //!< the device table (ISR delays)
+    std::vector<external_file>  external_files; //!< the external files table (program sizes)
+    program_catalog_t           catalog;        //!< the external files table, hashed
+};
+
 //Writes a string to a file
-void write_output(std::string execution, const char* filename) {
+void write_output(std::string_view execution, const char* filename) {
     std::ofstream output_file(filename);
 
     if (output_file.is_open()) {
@@ -222,7 +309,7 @@ void write_output(std::string execution, const char* filename) {
 }
 
 //Helper function for a sanity check. Prints the external files table
-void print_external_files(std::vector<external_file> files) {
+void print_external_files(const std::vector<external_file>& files) {
     const int tableWidth = 24;
 
     std::cout << "List of external files (" << files.size() << " entry(s)): " << std::endl;
@@ -255,7 +342,7 @@ void print_external_files(std::vector<external_file> files) {
 
 //This function takes as input: the current PCB and the waitqueue (which is a
 //std::vector of the PCB struct); the function returns the information as a table
-std::string print_PCB(PCB current, std::vector<PCB> _PCB) {
+std::string print_PCB(const PCB& current, const std::vector<PCB>& _PCB) {
     const int tableWidth = 55;
 
     std::stringstream buffer;
@@ -313,11 +400,12 @@ std::string print_PCB(PCB current, std::vector<PCB> _PCB) {
 }
 
 
-// Searches the external_files table and returns the size of the program
-unsigned int get_size(std::string name, std::vector<external_file> external_files) {
+// Searches the external_files table and returns the size of the program (-1 if it is not there).
+// This is a linear search; the simulator looks programs up in a program_catalog_t instead.
+unsigned int get_size(std::string_view name, const std::vector<external_file>& external_files) {
     int size = -1;
 
-    for (auto file : external_files) { 
+    for (const auto& file : external_files) {
         if(file.program_name == name){
             size = file.size;
             break;
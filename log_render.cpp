@@ -0,0 +1,57 @@
+/**
+ *
+ * @file log_render.cpp
+ * Renders a columnar log (written with --log-format=columnar) as the text logs,
+ * execution.txt and system_status.txt, the simulator would have written.
+ *
+ */
+
+#include "event_log.hpp"
+#include "mapped_file.hpp"
+
+int main(int argc, char** argv) {
+    if(argc != 3 && argc != 5) {
+        std::cout << "ERROR!\nExpected 2 or 4 arguments, received " << argc - 1 << std::endl;
+        std::cout << "To render a log, do: ./log_render <execution.simlog> <your_vector_table.txt> [<execution.txt> <system_status.txt>]" << std::endl;
+        exit(1);
+    }
+
+    mapped_file_t file(argv[1]);
+    if(!file.is_open()) {
+        std::cerr << "Error: Unable to open file: " << argv[1] << std::endl;
+        exit(1);
+    }
+
+    std::ifstream input_file(argv[2]);
+    if(!input_file.is_open()) {
+        std::cerr << "Error: Unable to open file: " << argv[2] << std::endl;
+        exit(1);
+    }
+    std::string vector;
+    std::vector<std::string> vectors;
+    while(std::getline(input_file, vector)) {
+        vectors.push_back(vector);
+    }
+    vector_table_t vector_table = make_vector_table(vectors);
+
+    file_sink_t execution(argc == 5 ? argv[3] : "execution.txt");
+    file_sink_t system_status(argc == 5 ? argv[4] : "system_status.txt");
+    if(!execution.is_open() || !system_status.is_open()) {
+        exit(1);
+    }
+
+    text_event_log_t log(execution, system_status, vector_table);
+    std::string error;
+    bool replayed = false;
+    try {
+        replayed = replay_event_log(file.contents(), log, error);
+    } catch(const std::out_of_range&) {
+        error = "interrupt number not in the vector table";
+    }
+    if(!replayed) {
+        std::cerr << "Error: " << argv[1] << ": " << error << std::endl;
+        exit(1);
+    }
+
+    return 0;
+}
@@ -0,0 +1,83 @@
+#ifndef MAPPED_FILE_HPP_
+#define MAPPED_FILE_HPP_
+
+#include<string>
+#include<string_view>
+#include<utility>
+
+#include<fcntl.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include<unistd.h>
+
+//A whole file mapped read-only into memory. The contents are valid for as long
+//as the object lives; nothing is copied. An empty file maps to an empty view.
+struct mapped_file_t {
+    const char* data = nullptr;
+    size_t      size = 0;
+    bool        opened = false;     //!< the file could be opened (it may still be empty)
+
+    mapped_file_t() = default;
+
+    explicit mapped_file_t(const std::string& filename) {
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if(fd < 0) {
+            return;
+        }
+
+        struct stat info;
+        if(::fstat(fd, &info) == 0 && S_ISREG(info.st_mode)) {
+            opened = true;
+            if(info.st_size > 0) {
+                void* mapping = ::mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if(mapping != MAP_FAILED) {
+                    data = static_cast<const char*>(mapping);
+                    size = info.st_size;
+                } else {
+                    opened = false;
+                }
+            }
+        }
+        ::close(fd);
+    }
+
+    ~mapped_file_t() {
+        unmap();
+    }
+
+    mapped_file_t(const mapped_file_t&) = delete;
+    mapped_file_t& operator=(const mapped_file_t&) = delete;
+
+    mapped_file_t(mapped_file_t&& other) noexcept {
+        *this = std::move(other);
+    }
+
+    mapped_file_t& operator=(mapped_file_t&& other) noexcept {
+        if(this != &other) {
+            unmap();
+            data = std::exchange(other.data, nullptr);
+            size = std::exchange(other.size, 0);
+            opened = std::exchange(other.opened, false);
+        }
+        return *this;
+    }
+
+    bool is_open() const {
+        return opened;
+    }
+
+    std::string_view contents() const {
+        return {data, size};
+    }
+
+private:
+    void unmap() {
+        if(data != nullptr) {
+            ::munmap(const_cast<char*>(data), size);
+            data = nullptr;
+            size = 0;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,479 @@
+#ifndef MEMORY_ALLOCATOR_HPP_
+#define MEMORY_ALLOCATOR_HPP_
+
+#include<iostream>
+#include<fstream>
+#include<iomanip>
+#include<string>
+#include<string_view>
+#include<vector>
+#include<set>
+#include<map>
+#include<memory>
+#include<chrono>
+#include<random>
+#include<climits>
+#include<algorithm>
+#include<cstdint>
+#include<stdexcept>
+
+#define MAX_PARTITIONS 1000000     //!< partitions a generated layout may have at most
+
+//How a partition is picked for a program
+enum class allocation_policy_t {
+    FIRST_FIT,  //!< the lowest numbered free partition that fits
+    BEST_FIT,   //!< the smallest free partition that fits (the highest numbered one on ties)
+    WORST_FIT,  //!< the largest free partition (the lowest numbered one on ties)
+    BUDDY       //!< power-of-two blocks split from, and merged back into, the whole memory
+};
+
+//Reads a policy name (first, best, worst or buddy). Returns false if it is not one.
+bool parse_allocation_policy(std::string_view name, allocation_policy_t& policy) {
+    if(name == "first") {
+        policy = allocation_policy_t::FIRST_FIT;
+    } else if(name == "best") {
+        policy = allocation_policy_t::BEST_FIT;
+    } else if(name == "worst") {
+        policy = allocation_policy_t::WORST_FIT;
+    } else if(name == "buddy") {
+        policy = allocation_policy_t::BUDDY;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* allocation_policy_name(allocation_policy_t policy) {
+    switch(policy) {
+        case allocation_policy_t::FIRST_FIT: return "first fit";
+        case allocation_policy_t::BEST_FIT:  return "best fit";
+        case allocation_policy_t::WORST_FIT: return "worst fit";
+        case allocation_policy_t::BUDDY:     return "buddy";
+    }
+    return "unknown";
+}
+
+struct allocator_stats_t {
+    uint64_t    allocations = 0;        //!< successful allocations
+    uint64_t    failures = 0;           //!< allocations that found no space
+    uint64_t    releases = 0;           //!< partitions freed (freeing a free partition does not count)
+    uint64_t    total_latency_ns = 0;   //!< time spent in allocate() and release()
+    uint64_t    max_latency_ns = 0;
+    uint64_t    requested = 0;          //!< size of the programs currently in memory
+    uint64_t    granted = 0;            //!< size of the partitions/blocks they were given
+};
+
+//Hands out partitions (or, for the buddy system, blocks) of memory to programs.
+//Partition numbers start at 1; a failed allocation returns -1.
+struct memory_allocator_t {
+    allocator_stats_t stats;
+
+    virtual ~memory_allocator_t() = default;
+
+    //Finds space for a program of the given size (owned by process 'owner') and returns its partition number (-1 if there is none)
+    int allocate(unsigned int size, int owner) {
+        auto start = std::chrono::steady_clock::now();
+        int partition = do_allocate(size, owner);
+        record_latency(start);
+
+        if(partition < 0) {
+            stats.failures++;
+        } else {
+            stats.allocations++;
+        }
+        return partition;
+    }
+
+    //Frees a partition. Freeing a partition that is already free does nothing.
+    void release(int partition_number) {
+        auto start = std::chrono::steady_clock::now();
+        if(do_release(partition_number)) {
+            stats.releases++;
+        }
+        record_latency(start);
+    }
+
+    virtual allocation_policy_t policy() const = 0;
+    virtual size_t partition_count() const = 0;     //!< partitions, or free and used blocks for the buddy system
+    virtual uint64_t total_size() const = 0;
+    virtual uint64_t free_size() const = 0;
+    virtual uint64_t largest_free() const = 0;
+    //PID of the process a partition was allocated to (-1 if it is free, or not a partition)
+    virtual int owner(int partition_number) const = 0;
+    //A copy of the allocator, in the same state (for checkpoints of a run)
+    virtual std::unique_ptr<memory_allocator_t> clone() const = 0;
+
+protected:
+    virtual int do_allocate(unsigned int size, int owner) = 0;
+    virtual bool do_release(int partition_number) = 0;
+
+    void record_latency(std::chrono::steady_clock::time_point start) {
+        uint64_t latency = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        stats.total_latency_ns += latency;
+        stats.max_latency_ns = std::max(stats.max_latency_ns, latency);
+    }
+};
+
+//The fixed partitions, one array per field: an allocator probe reads a size and
+//an occupancy bit instead of walking a table of structs with strings in them.
+struct partition_table_t {
+    std::vector<uint32_t>   sizes;      //!< size of partition i + 1, in Mb
+    std::vector<uint64_t>   occupied;   //!< bit i % 64 of word i / 64 is set if partition i + 1 is in use
+    std::vector<int32_t>    owners;     //!< PID of the process in partition i + 1 (-1 if free)
+    std::vector<uint32_t>   used;       //!< size of that process's program
+
+    explicit partition_table_t(const std::vector<unsigned int>& partition_sizes):
+        sizes(partition_sizes.begin(), partition_sizes.end()), occupied((partition_sizes.size() + 63) / 64, 0),
+        owners(partition_sizes.size(), -1), used(partition_sizes.size(), 0) {}
+
+    size_t size() const {
+        return sizes.size();
+    }
+
+    bool is_occupied(size_t index) const {
+        return (occupied[index / 64] >> (index % 64)) & 1;
+    }
+
+    void occupy(size_t index, int owner, unsigned int program_size) {
+        occupied[index / 64] |= uint64_t(1) << (index % 64);
+        owners[index] = owner;
+        used[index] = program_size;
+    }
+
+    void vacate(size_t index) {
+        occupied[index / 64] &= ~(uint64_t(1) << (index % 64));
+        owners[index] = -1;
+        used[index] = 0;
+    }
+};
+
+//Fixed partitions, found through two indexes of the free ones: an ordered set by
+//size (best and worst fit) and a max tree over partition numbers (first fit).
+//Allocating and freeing are O(log n) in the number of partitions.
+struct partition_allocator_t : memory_allocator_t {
+    allocation_policy_t                 fit;
+    partition_table_t                   table;
+    std::set<std::pair<unsigned int, int>> free_by_size;  //!< (size, -index) of every free partition
+    std::vector<uint64_t>               max_free;       //!< max tree: largest free partition (size + 1) under each node
+    size_t                              leaves = 1;
+    uint64_t                            free_total = 0;
+
+    partition_allocator_t(allocation_policy_t _fit, const std::vector<unsigned int>& partition_sizes):
+        fit(_fit), table(partition_sizes) {
+        while(leaves < table.size()) {
+            leaves *= 2;
+        }
+        max_free.assign(2 * leaves, 0);
+
+        for(size_t i = 0; i < table.size(); i++) {
+            mark_free(i);
+        }
+    }
+
+    allocation_policy_t policy() const override { return fit; }
+    size_t partition_count() const override { return table.size(); }
+    uint64_t free_size() const override { return free_total; }
+
+    uint64_t total_size() const override {
+        uint64_t total = 0;
+        for(uint32_t size : table.sizes) {
+            total += size;
+        }
+        return total;
+    }
+
+    uint64_t largest_free() const override {
+        return free_by_size.empty() ? 0 : free_by_size.rbegin()->first;
+    }
+
+    int owner(int partition_number) const override {
+        int index = partition_number - 1;
+        if(index < 0 || index >= static_cast<int>(table.size())) {
+            return -1;
+        }
+        return table.owners[index];
+    }
+
+    std::unique_ptr<memory_allocator_t> clone() const override {
+        return std::make_unique<partition_allocator_t>(*this);
+    }
+
+protected:
+    int do_allocate(unsigned int size, int owner) override {
+        int index = -1;
+
+        if(fit == allocation_policy_t::FIRST_FIT) {
+            index = first_fit(size);
+        } else if(fit == allocation_policy_t::BEST_FIT) {
+            auto found = free_by_size.lower_bound({size, INT_MIN});
+            if(found != free_by_size.end()) {
+                index = -found->second;
+            }
+        } else if(!free_by_size.empty() && free_by_size.rbegin()->first >= size) {
+            //worst fit: the largest partition ((size, -index) puts the lowest numbered last on ties)
+            index = -free_by_size.rbegin()->second;
+        }
+
+        if(index < 0) {
+            return -1;
+        }
+
+        mark_used(index, size, owner);
+        return index + 1;
+    }
+
+    bool do_release(int partition_number) override {
+        int index = partition_number - 1;
+        if(index < 0 || index >= static_cast<int>(table.size()) || !table.is_occupied(index)) {
+            return false;
+        }
+
+        stats.requested -= table.used[index];
+        stats.granted -= table.sizes[index];
+        mark_free(index);
+        return true;
+    }
+
+private:
+    void mark_free(size_t index) {
+        table.vacate(index);
+        free_by_size.insert({table.sizes[index], -static_cast<int>(index)});
+        free_total += table.sizes[index];
+        update_tree(index, uint64_t(table.sizes[index]) + 1);
+    }
+
+    void mark_used(size_t index, unsigned int size, int owner) {
+        table.occupy(index, owner, size);
+        free_by_size.erase({table.sizes[index], -static_cast<int>(index)});
+        free_total -= table.sizes[index];
+        update_tree(index, 0);
+
+        stats.requested += size;
+        stats.granted += table.sizes[index];
+    }
+
+    void update_tree(size_t index, uint64_t value) {
+        size_t node = leaves + index;
+        max_free[node] = value;
+        for(node /= 2; node >= 1; node /= 2) {
+            max_free[node] = std::max(max_free[2 * node], max_free[2 * node + 1]);
+        }
+    }
+
+    //Lowest numbered free partition of at least 'size' (-1 if there is none)
+    int first_fit(unsigned int size) const {
+        uint64_t needed = uint64_t(size) + 1;
+        if(table.size() == 0 || max_free[1] < needed) {
+            return -1;
+        }
+
+        size_t node = 1;
+        while(node < leaves) {
+            node = max_free[2 * node] >= needed ? 2 * node : 2 * node + 1;
+        }
+        return static_cast<int>(node - leaves);
+    }
+};
+
+//Buddy system over the whole memory (the sum of the partition sizes). Blocks are
+//powers of two (in Mb); a block's partition number is its start address + 1.
+//Free blocks are kept in one ordered set per size, so allocating and freeing
+//take O(log n) per split or merge.
+struct buddy_allocator_t : memory_allocator_t {
+    struct block_t {
+        unsigned int    order;
+        unsigned int    used;
+        int             owner;
+    };
+
+    uint64_t                                total = 0;
+    uint64_t                                free_total = 0;
+    std::vector<std::set<uint64_t>>         free_blocks;    //!< start addresses of the free blocks of size 2^order
+    std::map<uint64_t, block_t>             used_blocks;    //!< start address -> allocated block
+
+    explicit buddy_allocator_t(const std::vector<unsigned int>& partition_sizes) {
+        for(unsigned int size : partition_sizes) {
+            total += size;
+        }
+        free_blocks.resize(1);
+        while((uint64_t(1) << (free_blocks.size() - 1)) < total) {
+            free_blocks.emplace_back();
+        }
+
+        //cover the memory with the largest aligned blocks that fit
+        uint64_t start = 0;
+        for(size_t order = free_blocks.size(); order-- > 0;) {
+            if(start + (uint64_t(1) << order) <= total) {
+                free_blocks[order].insert(start);
+                start += uint64_t(1) << order;
+            }
+        }
+        free_total = total;
+    }
+
+    allocation_policy_t policy() const override { return allocation_policy_t::BUDDY; }
+    uint64_t total_size() const override { return total; }
+    uint64_t free_size() const override { return free_total; }
+
+    size_t partition_count() const override {
+        size_t count = used_blocks.size();
+        for(const auto& blocks : free_blocks) {
+            count += blocks.size();
+        }
+        return count;
+    }
+
+    uint64_t largest_free() const override {
+        for(size_t order = free_blocks.size(); order-- > 0;) {
+            if(!free_blocks[order].empty()) {
+                return uint64_t(1) << order;
+            }
+        }
+        return 0;
+    }
+
+    int owner(int partition_number) const override {
+        auto found = used_blocks.find(static_cast<uint64_t>(partition_number) - 1);
+        return partition_number < 1 || found == used_blocks.end() ? -1 : found->second.owner;
+    }
+
+    std::unique_ptr<memory_allocator_t> clone() const override {
+        return std::make_unique<buddy_allocator_t>(*this);
+    }
+
+protected:
+    int do_allocate(unsigned int size, int owner) override {
+        unsigned int order = 0;
+        while((uint64_t(1) << order) < size) {
+            order++;
+        }
+
+        size_t from = order;
+        while(from < free_blocks.size() && free_blocks[from].empty()) {
+            from++;
+        }
+        if(from >= free_blocks.size()) {
+            return -1;
+        }
+
+        uint64_t start = *free_blocks[from].begin();
+        free_blocks[from].erase(free_blocks[from].begin());
+        //split, keeping the lower half, until the block is the right size
+        while(from > order) {
+            from--;
+            free_blocks[from].insert(start + (uint64_t(1) << from));
+        }
+
+        used_blocks[start] = {order, size, owner};
+        free_total -= uint64_t(1) << order;
+        stats.requested += size;
+        stats.granted += uint64_t(1) << order;
+        return static_cast<int>(start + 1);
+    }
+
+    bool do_release(int partition_number) override {
+        auto found = used_blocks.find(static_cast<uint64_t>(partition_number) - 1);
+        if(partition_number < 1 || found == used_blocks.end()) {
+            return false;
+        }
+
+        uint64_t start = found->first;
+        unsigned int order = found->second.order;
+        stats.requested -= found->second.used;
+        stats.granted -= uint64_t(1) << order;
+        free_total += uint64_t(1) << order;
+        used_blocks.erase(found);
+
+        //merge with the buddy for as long as it is free too
+        while(order + 1 < free_blocks.size()) {
+            uint64_t buddy = start ^ (uint64_t(1) << order);
+            auto free_buddy = free_blocks[order].find(buddy);
+            if(free_buddy == free_blocks[order].end()) {
+                break;
+            }
+            free_blocks[order].erase(free_buddy);
+            start = std::min(start, buddy);
+            order++;
+        }
+        free_blocks[order].insert(start);
+        return true;
+    }
+};
+
+std::unique_ptr<memory_allocator_t> make_memory_allocator(allocation_policy_t policy, const std::vector<unsigned int>& partition_sizes) {
+    if(policy == allocation_policy_t::BUDDY) {
+        return std::make_unique<buddy_allocator_t>(partition_sizes);
+    }
+    return std::make_unique<partition_allocator_t>(policy, partition_sizes);
+}
+
+//Reads a memory layout file: one partition size (in Mb) per line, partition 1 first.
+//Blank lines and lines starting with '#' are skipped. Throws std::runtime_error if
+//the file cannot be read or holds no valid layout.
+std::vector<unsigned int> load_partition_layout(const std::string& filename) {
+    std::ifstream input_file(filename);
+    if(!input_file.is_open()) {
+        throw std::runtime_error("Unable to open file: " + filename);
+    }
+
+    std::vector<unsigned int> sizes;
+    std::string line;
+    while(std::getline(input_file, line)) {
+        size_t first = line.find_first_not_of(" \t\r");
+        if(first == std::string::npos || line[first] == '#') {
+            continue;
+        }
+
+        size_t end = 0;
+        long size = -1;
+        try {
+            size = std::stol(line.substr(first), &end);
+        } catch(const std::exception&) {
+        }
+        if(size <= 0 || size > UINT32_MAX || line.find_first_not_of(" \t\r", first + end) != std::string::npos) {
+            throw std::runtime_error("Invalid partition size '" + line + "' in " + filename);
+        }
+        sizes.push_back(static_cast<unsigned int>(size));
+    }
+
+    if(sizes.empty()) {
+        throw std::runtime_error("No partitions in " + filename);
+    }
+    return sizes;
+}
+
+//Makes up a layout of 'count' partitions of 1 to 64 Mb, largest first (like the
+//default layout). The same count always gives the same layout.
+std::vector<unsigned int> generate_partition_layout(size_t count, unsigned int seed = 1) {
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<unsigned int> size(1, 64);
+
+    std::vector<unsigned int> sizes(count);
+    for(auto& s : sizes) {
+        s = size(random);
+    }
+    std::sort(sizes.rbegin(), sizes.rend());
+    return sizes;
+}
+
+//Prints the allocation statistics: counts, latency and fragmentation
+void print_allocator_stats(std::ostream& out, const memory_allocator_t& allocator) {
+    const allocator_stats_t& stats = allocator.stats;
+    uint64_t calls = stats.allocations + stats.failures + stats.releases;
+
+    out << "Memory allocator: " << allocation_policy_name(allocator.policy())
+        << ", " << allocator.partition_count() << " partition(s), " << allocator.total_size() << " Mb" << std::endl;
+    out << "  allocations: " << stats.allocations << ", failed: " << stats.failures << ", freed: " << stats.releases << std::endl;
+    out << "  latency: " << (calls ? stats.total_latency_ns / calls : 0) << " ns average, "
+        << stats.max_latency_ns << " ns max" << std::endl;
+
+    //internal: space given to programs but not used by them; external: free space
+    //that is not in the largest free partition (so a program that size cannot use it)
+    double internal = stats.granted ? 100.0 * (stats.granted - stats.requested) / stats.granted : 0.0;
+    double external = allocator.free_size() ? 100.0 * (allocator.free_size() - allocator.largest_free()) / allocator.free_size() : 0.0;
+    out << std::fixed << std::setprecision(1)
+        << "  fragmentation: " << internal << "% internal, " << external << "% external" << std::endl;
+    out << std::defaultfloat;
+}
+
+#endif
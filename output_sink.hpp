@@ -0,0 +1,152 @@
+#ifndef OUTPUT_SINK_HPP_
+#define OUTPUT_SINK_HPP_
+
+#include<iostream>
+#include<fstream>
+#include<string>
+#include<string_view>
+#include<vector>
+#include<cstring>
+#include<cstdint>
+#include<charconv>
+#include<type_traits>
+
+#define SINK_BUFFER_SIZE (64 * 1024)
+
+//Destination for a log the simulator writes as it goes. Text (and integers, which
+//are formatted in place with std::to_chars) is collected in a fixed-size buffer and
+//handed to the backend ('emit') in chunks of up to SINK_BUFFER_SIZE bytes. Writing
+//never allocates, and the memory used does not depend on the length of the run.
+struct output_sink_t {
+    std::vector<char>   buffer;
+    size_t              used = 0;
+    uint64_t            emitted = 0;    //!< bytes handed to the backend so far
+
+    output_sink_t(): buffer(SINK_BUFFER_SIZE) {}
+    virtual ~output_sink_t() = default;
+
+    output_sink_t(const output_sink_t&) = delete;
+    output_sink_t& operator=(const output_sink_t&) = delete;
+
+    //Appends text to the log
+    void write(std::string_view text) {
+        if(used + text.size() > buffer.size()) {
+            flush();
+            if(text.size() > buffer.size()) {
+                emit(text.data(), text.size());
+                emitted += text.size();
+                return;
+            }
+        }
+        std::memcpy(buffer.data() + used, text.data(), text.size());
+        used += text.size();
+    }
+
+    //Appends the decimal form of an integer
+    template<typename T, typename std::enable_if<std::is_integral<T>::value, int>::type = 0>
+    void write(T value) {
+        const size_t max_digits = 24;
+        if(used + max_digits > buffer.size()) {
+            flush();
+        }
+        auto result = std::to_chars(buffer.data() + used, buffer.data() + buffer.size(), value);
+        used = result.ptr - buffer.data();
+    }
+
+    //Appends each argument in turn: strings as they are, integers in decimal.
+    //e.g. print(time, ", ", duration, ", CPU Burst\n")
+    template<typename... Args>
+    void print(const Args&... args) {
+        (write(args), ...);
+    }
+
+    //Hands everything written so far to the backend
+    void flush() {
+        if(used > 0) {
+            emit(buffer.data(), used);
+            emitted += used;
+            used = 0;
+        }
+    }
+
+    //Bytes written so far, handed to the backend or not
+    uint64_t size() const {
+        return emitted + used;
+    }
+
+protected:
+    //Backends must call flush() in their own destructor: by the time the base
+    //destructor runs, 'emit' no longer refers to them.
+    virtual void emit(const char* data, size_t size) = 0;
+};
+
+//Writes the log to a file, chunk by chunk, so whatever was flushed survives a crash
+struct file_sink_t : output_sink_t {
+    std::ofstream output_file;
+
+    explicit file_sink_t(const std::string& filename): output_file(filename, std::ios::binary) {
+        if(!output_file.is_open()) {
+            std::cerr << "Error opening file " << filename << "!" << std::endl;
+        }
+    }
+
+    ~file_sink_t() override {
+        close();
+    }
+
+    bool is_open() const {
+        return output_file.is_open();
+    }
+
+    //Flushes the remaining text and closes the file
+    void close() {
+        flush();
+        if(output_file.is_open()) {
+            output_file.close();
+        }
+    }
+
+protected:
+    void emit(const char* data, size_t size) override {
+        if(output_file.is_open()) {
+            output_file.write(data, size);
+            output_file.flush();
+        }
+    }
+};
+
+//Keeps the log in memory (for tests and for callers that post-process it)
+struct memory_sink_t : output_sink_t {
+    std::string contents;
+
+    ~memory_sink_t() override {
+        flush();
+    }
+
+    //Everything written so far
+    const std::string& str() {
+        flush();
+        return contents;
+    }
+
+protected:
+    void emit(const char* data, size_t size) override {
+        contents.append(data, size);
+    }
+};
+
+//Discards the log (for benchmarks)
+struct null_sink_t : output_sink_t {
+    size_t bytes = 0;   //!< total size of what was written
+
+    ~null_sink_t() override {
+        flush();
+    }
+
+protected:
+    void emit(const char*, size_t size) override {
+        bytes += size;
+    }
+};
+
+#endif
@@ -0,0 +1,319 @@
+#ifndef PROFILER_HPP_
+#define PROFILER_HPP_
+
+//Instrumentation of the simulator's hot paths. Built with -DSIM_PROFILE, every
+//phase and every trace opcode gets a scoped timer, call and allocation counters,
+//and PROFILE_REPORT() prints a summary and writes a Chrome trace (profile.json, or
+//$SIM_PROFILE_JSON) that chrome://tracing and Perfetto open. Without SIM_PROFILE
+//the macros expand to nothing and the simulator is not slowed down at all.
+//
+//  PROFILE_SCOPE(phase)        times the rest of the block as 'phase'
+//  PROFILE_OPCODE(op)          times the rest of the block as trace opcode 'op'
+//  PROFILE_RUN()               starts a new simulated timeline (one per simulation)
+//  PROFILE_SIM_EVENT(...)      adds a simulated event of a process to the timeline
+//  PROFILE_REPORT()            prints the summary and writes the timeline
+
+enum class phase_t {
+    COMPILE,        //!< parsing trace text into instructions
+    LOAD_BINARY,    //!< mapping and checking a binary trace
+    PROGRAM_LOAD,   //!< loading a program file for EXEC (through the program cache)
+    BRANCH_TABLES,  //!< resolving the FORKs of a view (extracting the children)
+    SIMULATE,       //!< a whole simulation
+    ALLOCATE,       //!< allocate_memory
+    FREE,           //!< free_memory
+    LOG,            //!< formatting and writing the logs
+    COUNT
+};
+
+#define PROFILE_OPCODES 9   //!< opcode_t values
+
+#ifdef SIM_PROFILE
+
+#include<array>
+#include<atomic>
+#include<chrono>
+#include<cstdlib>
+#include<fstream>
+#include<iomanip>
+#include<iostream>
+#include<memory>
+#include<mutex>
+#include<new>
+#include<string>
+#include<vector>
+
+#define PROFILE_SLOTS       (static_cast<int>(phase_t::COUNT) + PROFILE_OPCODES)
+#define PROFILE_MAX_SPANS   200000  //!< host spans kept per thread
+#define PROFILE_MAX_EVENTS  500000  //!< simulated events kept per run
+
+const char* profile_slot_name(int slot) {
+    static const char* names[PROFILE_SLOTS] = {
+        "compile", "load binary trace", "program load", "branch tables", "simulate", "allocate", "free", "log",
+        "NOP", "CPU", "SYSCALL", "END_IO", "FORK", "IF_CHILD", "IF_PARENT", "ENDIF", "EXEC"};
+    return names[slot];
+}
+
+//What one phase or opcode cost on one thread (time includes the scopes nested in it)
+struct profile_counter_t {
+    uint64_t    calls = 0;
+    uint64_t    ns = 0;
+    uint64_t    allocations = 0;    //!< made while this was the innermost scope
+};
+
+//A timed phase on the host (wall time since the profiler started)
+struct profile_span_t {
+    int         slot;
+    int64_t     start_ns;
+    int64_t     duration_ns;
+};
+
+//A simulated event of a process (simulated ms)
+struct profile_sim_event_t {
+    const char* name;
+    int32_t     pid;
+    int32_t     time;
+    int32_t     duration;
+};
+
+struct profile_run_t {
+    uint32_t                            thread;
+    std::vector<profile_sim_event_t>    events;
+    uint64_t                            dropped = 0;
+};
+
+struct thread_profile_t {
+    uint32_t                                        id;
+    std::array<profile_counter_t, PROFILE_SLOTS>    counters;
+    std::vector<profile_span_t>                     spans;
+    uint64_t                                        dropped_spans = 0;
+    profile_run_t*                                  run = nullptr;  //!< the simulation this thread is running
+};
+
+//Allocations are counted without allocating, so the counters are plain thread locals
+thread_local profile_counter_t* profile_alloc_target = nullptr;
+thread_local uint64_t           profile_thread_allocations = 0;
+std::atomic<uint64_t>           profile_total_allocations{0};
+
+struct profiler_t {
+    std::mutex                                      lock;
+    std::vector<std::unique_ptr<thread_profile_t>>  threads;
+    std::vector<std::unique_ptr<profile_run_t>>     runs;
+    std::chrono::steady_clock::time_point           start = std::chrono::steady_clock::now();
+
+    int64_t now_ns() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+};
+
+profiler_t& profiler() {
+    static profiler_t instance;
+    return instance;
+}
+
+//The profile of the calling thread (created the first time it is needed)
+thread_profile_t& thread_profile() {
+    thread_local thread_profile_t* local = nullptr;
+    if(local == nullptr) {
+        profiler_t& p = profiler();
+        std::lock_guard<std::mutex> guard(p.lock);
+        p.threads.push_back(std::make_unique<thread_profile_t>());
+        local = p.threads.back().get();
+        local->id = p.threads.size() - 1;
+    }
+    return *local;
+}
+
+//Times a scope and makes it the target of the allocations made inside it
+struct profile_scope_t {
+    thread_profile_t&   thread;
+    int                 slot;
+    bool                timeline;
+    int64_t             start;
+    profile_counter_t*  outer;
+
+    profile_scope_t(int _slot, bool _timeline):
+        thread(thread_profile()), slot(_slot), timeline(_timeline), start(profiler().now_ns()), outer(profile_alloc_target) {
+        profile_alloc_target = &thread.counters[slot];
+    }
+
+    ~profile_scope_t() {
+        int64_t duration = profiler().now_ns() - start;
+        profile_counter_t& counter = thread.counters[slot];
+        counter.calls++;
+        counter.ns += duration;
+        profile_alloc_target = outer;
+        if(timeline) {
+            if(thread.spans.size() < PROFILE_MAX_SPANS) {
+                profile_counter_t* saved = profile_alloc_target;
+                profile_alloc_target = nullptr;     //the profiler's own allocations are not charged to the phase
+                thread.spans.push_back({slot, start, duration});
+                profile_alloc_target = saved;
+            } else {
+                thread.dropped_spans++;
+            }
+        }
+    }
+};
+
+//Starts the simulated timeline of a new run on this thread
+void profile_begin_run() {
+    thread_profile_t& thread = thread_profile();
+    profiler_t& p = profiler();
+    std::lock_guard<std::mutex> guard(p.lock);
+    p.runs.push_back(std::make_unique<profile_run_t>());
+    p.runs.back()->thread = thread.id;
+    thread.run = p.runs.back().get();
+}
+
+void profile_sim_event(const char* name, int pid, int time, int duration) {
+    profile_run_t* run = thread_profile().run;
+    if(run == nullptr) {
+        return;
+    }
+    if(run->events.size() < PROFILE_MAX_EVENTS) {
+        profile_counter_t* saved = profile_alloc_target;
+        profile_alloc_target = nullptr;
+        run->events.push_back({name, pid, time, duration});
+        profile_alloc_target = saved;
+    } else {
+        run->dropped++;
+    }
+}
+
+//Writes a string as a JSON string
+void write_json_string(std::ostream& out, const char* text) {
+    out << '"';
+    for(; *text; text++) {
+        if(*text == '"' || *text == '\\') {
+            out << '\\';
+        }
+        out << *text;
+    }
+    out << '"';
+}
+
+/**
+ * \brief print the profile and write the timeline
+ *
+ * The summary (per phase, then per opcode: calls, total and average time, and the
+ * allocations made in each) goes to 'out'. The timeline is a Chrome trace: process
+ * "host" has a thread per simulator thread with its phases in wall time, and each
+ * simulation is a process "simulated run <n>" with a thread per simulated PID and
+ * its events in simulated time (1 simulated ms is shown as 1 ms).
+ *
+ * @param out where the summary goes
+ * @param json_filename where the timeline is written
+ *
+ */
+void profile_report(std::ostream& out, const std::string& json_filename) {
+    profiler_t& p = profiler();
+    std::lock_guard<std::mutex> guard(p.lock);
+
+    std::array<profile_counter_t, PROFILE_SLOTS> totals;
+    uint64_t dropped_spans = 0;
+    for(const auto& thread : p.threads) {
+        for(int slot = 0; slot < PROFILE_SLOTS; slot++) {
+            totals[slot].calls += thread->counters[slot].calls;
+            totals[slot].ns += thread->counters[slot].ns;
+            totals[slot].allocations += thread->counters[slot].allocations;
+        }
+        dropped_spans += thread->dropped_spans;
+    }
+
+    out << "Profile (" << p.threads.size() << " thread(s), " << profile_total_allocations << " allocations in total; times include nested phases)" << std::endl;
+    out << std::left << std::setw(20) << "phase / opcode" << std::right << std::setw(12) << "calls" << std::setw(14) << "total ms"
+        << std::setw(12) << "avg us" << std::setw(14) << "allocations" << std::endl;
+    out << std::fixed << std::setprecision(3);
+    for(int slot = 0; slot < PROFILE_SLOTS; slot++) {
+        const profile_counter_t& counter = totals[slot];
+        if(counter.calls == 0) {
+            continue;
+        }
+        out << std::left << std::setw(20) << profile_slot_name(slot) << std::right << std::setw(12) << counter.calls
+            << std::setw(14) << counter.ns / 1e6 << std::setw(12) << counter.ns / 1e3 / counter.calls
+            << std::setw(14) << counter.allocations << std::endl;
+    }
+    out << std::defaultfloat;
+
+    std::ofstream json(json_filename);
+    if(!json.is_open()) {
+        std::cerr << "Error opening file " << json_filename << "!" << std::endl;
+        return;
+    }
+    json << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    json << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"host\"}}";
+    for(const auto& thread : p.threads) {
+        for(const auto& span : thread->spans) {
+            json << ",\n{\"name\":";
+            write_json_string(json, profile_slot_name(span.slot));
+            json << ",\"cat\":\"host\",\"ph\":\"X\",\"pid\":0,\"tid\":" << thread->id
+                 << ",\"ts\":" << span.start_ns / 1000.0 << ",\"dur\":" << span.duration_ns / 1000.0 << "}";
+        }
+    }
+    uint64_t dropped_events = 0;
+    for(size_t r = 0; r < p.runs.size(); r++) {
+        const profile_run_t& run = *p.runs[r];
+        json << ",\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << r + 1 << ",\"args\":{\"name\":\"simulated run " << r + 1
+             << " (host thread " << run.thread << ")\"}}";
+        for(const auto& event : run.events) {
+            json << ",\n{\"name\":";
+            write_json_string(json, event.name);
+            json << ",\"cat\":\"simulated\",\"ph\":\"X\",\"pid\":" << r + 1 << ",\"tid\":" << event.pid
+                 << ",\"ts\":" << int64_t(event.time) * 1000 << ",\"dur\":" << int64_t(event.duration) * 1000 << "}";
+        }
+        dropped_events += run.dropped;
+    }
+    json << "\n]}\n";
+
+    out << "Timeline written to " << json_filename;
+    if(dropped_spans || dropped_events) {
+        out << " (" << dropped_spans << " host spans and " << dropped_events << " simulated events over the limit left out)";
+    }
+    out << std::endl;
+}
+
+//Counts every allocation. The replacements are never inlined: the compiler would
+//otherwise pair the malloc and free they inline to with the new and delete
+//expressions of the standard library and report them as mismatched.
+[[gnu::noinline]] void* operator new(std::size_t size) {
+    profile_total_allocations.fetch_add(1, std::memory_order_relaxed);
+    profile_thread_allocations++;
+    if(profile_alloc_target != nullptr) {
+        profile_alloc_target->allocations++;
+    }
+    if(void* block = std::malloc(size ? size : 1)) {
+        return block;
+    }
+    throw std::bad_alloc();
+}
+
+[[gnu::noinline]] void operator delete(void* block) noexcept {
+    std::free(block);
+}
+
+[[gnu::noinline]] void operator delete(void* block, std::size_t) noexcept {
+    std::free(block);
+}
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(phase) \
+    profile_scope_t PROFILE_CONCAT(profile_scope_, __LINE__)(static_cast<int>(phase), (phase) != phase_t::ALLOCATE && (phase) != phase_t::FREE && (phase) != phase_t::LOG)
+#define PROFILE_OPCODE(op) \
+    profile_scope_t PROFILE_CONCAT(profile_scope_, __LINE__)(static_cast<int>(phase_t::COUNT) + static_cast<int>(op), false)
+#define PROFILE_RUN() profile_begin_run()
+#define PROFILE_SIM_EVENT(name, pid, time, duration) profile_sim_event(name, pid, time, duration)
+#define PROFILE_REPORT() \
+    profile_report(std::cerr, std::getenv("SIM_PROFILE_JSON") ? std::getenv("SIM_PROFILE_JSON") : "profile.json")
+
+#else
+
+#define PROFILE_SCOPE(phase)
+#define PROFILE_OPCODE(op)
+#define PROFILE_RUN()
+#define PROFILE_SIM_EVENT(name, pid, time, duration)
+#define PROFILE_REPORT()
+
+#endif
+
+#endif
@@ -1,7 +1,7 @@
 #!/bin/bash
 
 # SYSC4001 Assignment 2 Part 3 - Test Runner Script
-# This script runs all 5 test cases and outputs results to output_files folder
+# This script runs every test case in input_files and outputs results to output_files folder
 
 echo "=========================================="
 echo "SYSC4001 Assignment 2 - Running Test Cases"
@@ -18,26 +18,38 @@ fi
 # Create output_files directory if it doesn't exist
 mkdir -p output_files
 
-# Function to run a single test
-run_test() {
+# Copy a test's input files to root directory (where program expects them)
+copy_inputs() {
     local test_num=$1
-    echo "Running Test $test_num..."
-    echo "------------------------"
-
-    # Copy input files to root directory (where program expects them)
     cp input_files/test${test_num}_trace.txt trace.txt
     cp input_files/test${test_num}_external_files.txt external_files.txt
 
     # Copy program files
-    if [ -f "input_files/test${test_num}_program1.txt" ]; then
-        cp input_files/test${test_num}_program1.txt program1.txt
-    fi
-    if [ -f "input_files/test${test_num}_program2.txt" ]; then
-        cp input_files/test${test_num}_program2.txt program2.txt
+    for program in input_files/test${test_num}_program*.txt; do
+        if [ -f "$program" ]; then
+            cp "$program" "${program#input_files/test${test_num}_}"
+        fi
+    done
+}
+
+# Extra command line options of a test (if it has any)
+test_options() {
+    if [ -f "input_files/test$1_options.txt" ]; then
+        cat input_files/test$1_options.txt
     fi
+}
+
+# Function to run a single test
+run_test() {
+    local test_num=$1
+    echo "Running Test $test_num..."
+    echo "------------------------"
+
+    copy_inputs $test_num
+    local options=$(test_options $test_num)
 
     # Run the simulator
-    ./bin/interrupts trace.txt vector_table.txt device_table.txt external_files.txt
+    ./bin/interrupts trace.txt vector_table.txt device_table.txt external_files.txt $options
 
     # Move output files to output_files directory
     if [ -f "execution.txt" ]; then
@@ -54,13 +66,89 @@ run_test() {
     echo ""
 }
 
-# Run all 5 tests
-for i in {1..5}; do
+# Run every test in input_files, in order
+for i in $(ls input_files/test*_trace.txt | sed 's/input_files\/test\([0-9]*\)_trace.txt/\1/' | sort -n); do
     run_test $i
 done
 
+# Check the delta status log of a test run with the given options against its text
+# one: status_reader must print the whole system_status.txt back, and the last table
+# logged at each snapshot's time when asked for that time
+status_failed=0
+check_status_delta() {
+    local test_num=$1
+    shift
+    local dir=$(mktemp -d)
+    copy_inputs $test_num
+    ./bin/interrupts trace.txt vector_table.txt device_table.txt external_files.txt "$@" > /dev/null 2>&1
+    mv system_status.txt "$dir/system_status.txt"
+    ./bin/interrupts trace.txt vector_table.txt device_table.txt external_files.txt "$@" --status-format=delta > /dev/null 2>&1
+    mv system_status.delta "$dir/system_status.delta"
+    rm -f execution.txt
+
+    local result="ok"
+    ./bin/status_reader "$dir/system_status.delta" > "$dir/replayed.txt" 2>&1
+    if ! cmp -s "$dir/replayed.txt" "$dir/system_status.txt"; then
+        result="FAILED (whole log)"
+    fi
+    for time in $(sed -n 's/^time: \([0-9]*\);.*/\1/p' "$dir/system_status.txt" | sort -un); do
+        awk -v time=$time '/^time: / { keep = ($2 + 0 == time); if(keep) table = "" } keep { table = table $0 "\n" } END { printf "%s", table }' \
+            "$dir/system_status.txt" > "$dir/expected.txt"
+        ./bin/status_reader "$dir/system_status.delta" $time > "$dir/replayed.txt" 2>&1
+        if ! cmp -s "$dir/replayed.txt" "$dir/expected.txt"; then
+            result="FAILED (table at time $time)"
+            break
+        fi
+    done
+    echo "Status log round trip: test $test_num${*:+ $*}: $result"
+    if [ "$result" != "ok" ]; then
+        status_failed=1
+    fi
+    rm -rf "$dir"
+}
+
+for i in $(ls input_files/test*_trace.txt | sed 's/input_files\/test\([0-9]*\)_trace.txt/\1/' | sort -n); do
+    check_status_delta $i $(test_options $i)
+done
+echo ""
+
+# Run test 1 through the batch driver next to scenarios whose external files table is
+# malformed (a line without a size, a blank line): those must be reported as failed,
+# and test 1 must still run and give the same logs as above
+batch_failed=0
+check_batch_errors() {
+    local dir=$(mktemp -d)
+    local inputs="input_files/test1_trace.txt, vector_table.txt, device_table.txt"
+    printf 'program1\n' > "$dir/no_size.txt"
+    printf 'program1, 10\n\n' > "$dir/blank_line.txt"
+    {
+        echo "test1, $inputs, input_files/test1_external_files.txt, input_files/test1_"
+        echo "no_size, $inputs, $dir/no_size.txt, input_files/test1_"
+        echo "blank_line, $inputs, $dir/blank_line.txt, input_files/test1_"
+    } > "$dir/manifest.txt"
+    ./bin/batch "$dir/manifest.txt" --output-dir="$dir" > "$dir/batch.txt" 2>&1
+    local code=$?
+
+    local result="ok"
+    if [ $code -ne 1 ]; then
+        result="FAILED (exit code $code)"
+    elif [ $(grep -c "FAILED  Invalid external file" "$dir/batch.txt") -ne 2 ]; then
+        result="FAILED (malformed tables not reported)"
+    elif ! cmp -s "$dir/test1_execution.txt" output_files/test1_execution.txt; then
+        result="FAILED (test 1 logs differ)"
+    fi
+    echo "Batch with malformed external files: $result"
+    if [ "$result" != "ok" ]; then
+        batch_failed=1
+    fi
+    rm -rf "$dir"
+}
+
+check_batch_errors
+echo ""
+
 # Clean up temporary files
-rm -f trace.txt external_files.txt program1.txt program2.txt
+rm -f trace.txt external_files.txt program[0-9]*.txt
 
 echo "=========================================="
 echo "All tests completed!"
@@ -70,3 +158,5 @@ echo ""
 ls -1 output_files/
 echo ""
 echo "You can now view the results"
+
+exit $((status_failed || batch_failed))
@@ -0,0 +1,753 @@
+#ifndef SCHEDULER_HPP_
+#define SCHEDULER_HPP_
+
+#include "simulator.hpp"
+#include "devices.hpp"
+
+#include<algorithm>
+#include<deque>
+#include<queue>
+#include<climits>
+
+#define DEFAULT_QUANTUM 50
+#define NO_PROCESS UINT32_MAX
+#define NO_CORE UINT32_MAX
+
+//How the next process is picked from the ready queue
+enum class scheduling_policy_t {
+    FCFS,           //!< in the order processes became ready
+    PRIORITY,       //!< lowest priority number first (FCFS on ties); a process runs until it blocks or ends
+    ROUND_ROBIN     //!< FCFS, but a CPU burst is preempted when the quantum runs out
+};
+
+//Reads a policy name (fcfs, priority or rr). Returns false if it is not one.
+bool parse_scheduling_policy(std::string_view name, scheduling_policy_t& policy) {
+    if(name == "fcfs") {
+        policy = scheduling_policy_t::FCFS;
+    } else if(name == "priority") {
+        policy = scheduling_policy_t::PRIORITY;
+    } else if(name == "rr") {
+        policy = scheduling_policy_t::ROUND_ROBIN;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* scheduling_policy_name(scheduling_policy_t policy) {
+    switch(policy) {
+        case scheduling_policy_t::FCFS:        return "FCFS";
+        case scheduling_policy_t::PRIORITY:    return "priority";
+        case scheduling_policy_t::ROUND_ROBIN: return "round robin";
+    }
+    return "unknown";
+}
+
+struct scheduler_config_t {
+    scheduling_policy_t policy = scheduling_policy_t::FCFS;
+    int                 quantum = DEFAULT_QUANTUM;  //!< ms of CPU burst per turn (round robin only)
+    io_model_t          io = io_model_t::IDEAL;
+    uint32_t            cores = 1;
+};
+
+//A process known to the scheduler: its PCB, where it is in its view, and its timings
+struct scheduled_process_t {
+    PCB             pcb;
+    uint32_t        view;
+    view_cursor_t   cursor;
+    int             priority;
+    process_state_t state = process_state_t::READY;
+    uint32_t        core = 0;           //!< the core whose run queue it goes back to
+    int             burst_left = 0;     //!< what is left of a preempted CPU burst (0 if none)
+    int             arrival;            //!< when the process was created
+    int             ready_since = 0;    //!< when it last entered the ready queue
+    int             first_run = -1;     //!< when it was first dispatched
+    int             completion = -1;    //!< when it ended
+    int64_t         waited = 0;         //!< total time spent in the ready queue
+    bool            changed = false;    //!< its row changed since the last snapshot (see schedule_trace)
+
+    scheduled_process_t(PCB _pcb, uint32_t _view, view_cursor_t _cursor, int _priority, int _arrival):
+        pcb(std::move(_pcb)), view(_view), cursor(_cursor), priority(_priority), arrival(_arrival) {}
+};
+
+//The ready queue: a FIFO for FCFS and round robin, a heap ordered by (priority, arrival in the queue) otherwise.
+//On several cores a process can be queued before it is ready (at the end of an ISR that
+//a core whose clock is ahead ran), so pop() passes over the processes that are not ready
+//yet and takes the first one, in the queue's order, that is.
+struct ready_queue_t {
+    typedef std::tuple<int, uint64_t, uint32_t, int> entry_t;  //!< (priority, sequence number, process, ready time)
+
+    scheduling_policy_t     policy;
+    std::deque<entry_t>     fifo;
+    std::vector<entry_t>    by_priority;    //!< a min-heap
+    uint64_t                sequence = 0;
+
+    explicit ready_queue_t(scheduling_policy_t _policy): policy(_policy) {}
+
+    void push(uint32_t process, int priority, int ready_time) {
+        if(policy == scheduling_policy_t::PRIORITY) {
+            by_priority.emplace_back(priority, sequence++, process, ready_time);
+            std::push_heap(by_priority.begin(), by_priority.end(), std::greater<entry_t>());
+        } else {
+            fifo.emplace_back(0, sequence++, process, ready_time);
+        }
+    }
+
+    //Takes the first process that is ready by 'now' (NO_PROCESS if none is)
+    uint32_t pop(int now) {
+        uint32_t process = NO_PROCESS;
+        if(policy == scheduling_policy_t::PRIORITY) {
+            //pops the processes ahead of it (not ready yet) to the end of the heap, then puts them back
+            auto heap_end = by_priority.end();
+            while(heap_end != by_priority.begin()) {
+                std::pop_heap(by_priority.begin(), heap_end, std::greater<entry_t>());
+                --heap_end;
+                if(std::get<3>(*heap_end) <= now) {
+                    process = std::get<2>(*heap_end);
+                    heap_end = by_priority.erase(heap_end);
+                    break;
+                }
+            }
+            while(heap_end != by_priority.end()) {
+                std::push_heap(by_priority.begin(), ++heap_end, std::greater<entry_t>());
+            }
+        } else {
+            auto ready = std::find_if(fifo.begin(), fifo.end(), [now](const entry_t& entry) { return std::get<3>(entry) <= now; });
+            if(ready != fifo.end()) {
+                process = std::get<2>(*ready);
+                fifo.erase(ready);
+            }
+        }
+        return process;
+    }
+
+    //Whether a process is ready by 'now'
+    bool ready_by(int now) const {
+        auto ready = [now](const entry_t& entry) { return std::get<3>(entry) <= now; };
+        return policy == scheduling_policy_t::PRIORITY ? std::any_of(by_priority.begin(), by_priority.end(), ready)
+                                                       : std::any_of(fifo.begin(), fifo.end(), ready);
+    }
+
+    //When the first process is ready (INT_MAX if there is none)
+    int ready_at() const {
+        int first = INT_MAX;
+        auto earliest = [&first](const entry_t& entry) { first = std::min(first, std::get<3>(entry)); };
+        if(policy == scheduling_policy_t::PRIORITY) {
+            std::for_each(by_priority.begin(), by_priority.end(), earliest);
+        } else {
+            std::for_each(fifo.begin(), fifo.end(), earliest);
+        }
+        return first;
+    }
+
+    size_t size() const {
+        return policy == scheduling_policy_t::PRIORITY ? by_priority.size() : fifo.size();
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+};
+
+//How one core spent its time
+struct core_metrics_t {
+    uint64_t    dispatches = 0;
+    uint64_t    steals = 0;         //!< processes taken from another core's run queue
+    uint64_t    interrupts = 0;     //!< device completions taken (queued I/O goes to core 0)
+    int64_t     user = 0;           //!< time in CPU bursts
+    int64_t     idle = 0;           //!< the rest is kernel time: interrupts and ISRs
+};
+
+//One simulated CPU: its own clock and run queue, and the process it runs
+struct core_t {
+    int             clock;
+    ready_queue_t   ready;
+    uint32_t        running = NO_PROCESS;
+    int             quantum_left = 0;
+    bool            parked = false;     //!< nothing to run: it waits until 'wake' (or a device interrupt, for core 0)
+    int             wake = INT_MAX;
+    bool            idle = false;       //!< idle since 'idle_since' (logged once it runs something again)
+    int             idle_since = 0;
+    core_metrics_t  metrics;
+
+    core_t(scheduling_policy_t policy, int time): clock(time), ready(policy) {}
+};
+
+struct scheduler_metrics_t {
+    scheduler_config_t  config;
+    uint64_t            processes = 0;          //!< processes created (init included)
+    uint64_t            completed = 0;
+    uint64_t            context_switches = 0;   //!< dispatches
+    uint64_t            preemptions = 0;        //!< quantum expiries that switched process
+    int                 start = 0;
+    int                 end = 0;
+    int64_t             idle = 0;               //!< time with no process ready
+    int64_t             turnaround = 0;         //!< sum over completed processes of completion - arrival
+    int64_t             waiting = 0;            //!< sum of time completed processes spent in the ready queue
+    int64_t             response = 0;           //!< sum of first dispatch - arrival
+    std::vector<device_metrics_t> devices;      //!< every device used (queued I/O only)
+    std::vector<core_metrics_t>   cores;
+};
+
+//Logs a system status snapshot with every process that has not ended
+void write_process_table(event_log_t& log, int time, opcode_t trace, int operand, std::string_view program, const std::vector<scheduled_process_t>& processes) {
+    log.snapshot(time, trace, operand, program);
+    for(const auto& process : processes) {
+        if(process.state != process_state_t::TERMINATED) {
+            log.snapshot_row(process.pcb, process.state);
+        }
+    }
+    log.snapshot_end();
+}
+
+//The system status snapshots of a multi-core run, held back until no core can log
+//an earlier one. A core runs a whole instruction at once, so the snapshot it logs
+//at the end can be later than one that a core whose clock is still behind is yet
+//to log; releasing them once every core's clock has passed them keeps the system
+//status log in time order, as the readers of its snapshots expect.
+struct snapshot_queue_t {
+    struct held_snapshot_t {
+        int                                             time;
+        opcode_t                                        trace;
+        int                                             operand;
+        std::string                                     program;
+        std::vector<std::pair<PCB, process_state_t>>    rows;
+    };
+
+    std::deque<held_snapshot_t> held;   //!< in time order (in the order they were taken, on ties)
+
+    //Takes a snapshot of every process that has not ended (see write_process_table)
+    void hold(int time, opcode_t trace, int operand, std::string_view program, const std::vector<scheduled_process_t>& processes) {
+        auto after = std::upper_bound(held.begin(), held.end(), time, [](int t, const held_snapshot_t& snapshot) { return t < snapshot.time; });
+        held_snapshot_t& snapshot = *held.insert(after, {time, trace, operand, std::string(program), {}});
+        for(const auto& process : processes) {
+            if(process.state != process_state_t::TERMINATED) {
+                snapshot.rows.emplace_back(process.pcb, process.state);
+            }
+        }
+    }
+
+    //Logs the snapshots taken before 'time', in time order
+    void release(event_log_t& log, int time) {
+        while(!held.empty() && held.front().time < time) {
+            const held_snapshot_t& snapshot = held.front();
+            log.snapshot(snapshot.time, snapshot.trace, snapshot.operand, snapshot.program);
+            for(const auto& [pcb, state] : snapshot.rows) {
+                log.snapshot_row(pcb, state);
+            }
+            log.snapshot_end();
+            held.pop_front();
+        }
+    }
+};
+
+/**
+ * \brief run a compiled trace under a scheduler
+ *
+ * Unlike simulate_trace, a FORK does not run the child to completion: the child
+ * goes to the ready queue and the parent carries on. A SYSCALL starts the device
+ * and blocks the process in the wait queue until the device's delay has passed,
+ * and the CPU is given to the next ready process in the meantime (or idles if
+ * there is none). Each process keeps its own view and cursor, so processes can be
+ * switched at any instruction, and round robin can also split a CPU burst.
+ * Interrupt service routines are never preempted. A process that ends frees the
+ * partition its last EXEC allocated (a child that never EXECed shares its
+ * parent's, which stays allocated).
+ *
+ * With queued I/O, a SYSCALL is a request to its device, which serves one request
+ * at a time in order (see device_bank_t), and the process waits until the device
+ * is done with it. The device then interrupts the CPU: the completion ISR runs
+ * at that time, in the middle of a CPU burst if need be (the burst carries on
+ * after it), and puts the process back in the ready queue. That interrupt is the
+ * END_IO of the request, so the END_IO that follows in the trace does nothing.
+ *
+ * With several cores, each core has its own clock and run queue, and the core
+ * whose clock is the earliest always runs next, so nothing a core does can be
+ * seen by a core whose clock is still before it. A forked child goes to the run
+ * queue of the core that forked it, and a process back from I/O or preempted to
+ * the queue of the core it last ran on. A core whose queue has nothing ready
+ * steals the next process from the core with the longest queue; if there is
+ * nothing to steal it idles until a process is ready somewhere. Each core pays
+ * for the interrupts and ISRs it runs (device interrupts go to core 0). The
+ * system status snapshots are logged in time order (see snapshot_queue_t), the
+ * execution events as each core runs them.
+ *
+ * On one core, a log that keeps the process table (see event_log_t::keeps_table)
+ * is only given the rows that changed since the snapshot before: the scheduler
+ * lists the processes it makes ready, dispatches, blocks, EXECs or ends.
+ *
+ * @param compiled the compiled trace (child views are resolved into it as they first run)
+ * @param view_id the view init runs
+ * @param time the simulated time to start at
+ * @param context the vector, device and external files tables
+ * @param machine the memory and PID counter the run allocates from
+ * @param init the PCB of the first process
+ * @param config the scheduling policy, quantum, I/O model and number of cores
+ * @param log where the execution events and system status snapshots go, as they happen
+ * @param metrics filled with the throughput, turnaround and wait times of the run
+ * @return the time at the end
+ *
+ */
+int schedule_trace(compiled_trace_t& compiled, uint32_t view_id, int time, const simulation_context_t& context, machine_t& machine, PCB init, const scheduler_config_t& config, event_log_t& log, scheduler_metrics_t& metrics) {
+    PROFILE_SCOPE(phase_t::SIMULATE);
+
+    const std::vector<int>& delays = context.delays;
+    const bool round_robin = config.policy == scheduling_policy_t::ROUND_ROBIN;
+    const bool queued_io = config.io == io_model_t::QUEUED;
+    const bool multicore = config.cores > 1;
+
+    const std::vector<int64_t> program_sizes = link_program_sizes(compiled, context.catalog);
+
+    typedef std::tuple<int, uint64_t, uint32_t> io_t;      //!< (I/O done time, sequence number, process)
+    std::vector<scheduled_process_t> processes;
+    std::vector<core_t> cores(std::max<uint32_t>(config.cores, 1), core_t(config.policy, time));
+    std::priority_queue<io_t, std::vector<io_t>, std::greater<io_t>> waiting;
+    uint64_t io_sequence = 0;
+    device_bank_t devices(delays);
+    snapshot_queue_t snapshots;
+    const bool log_changes = !multicore && log.keeps_table();
+    std::vector<uint32_t> changed;      //!< the processes whose row changed since the last snapshot (log_changes only)
+
+    metrics = scheduler_metrics_t();
+    metrics.config = config;
+    metrics.start = time;
+
+    //lists a process whose row in the process table changed
+    auto row_changed = [&](uint32_t id) {
+        if(log_changes && !processes[id].changed) {
+            processes[id].changed = true;
+            changed.push_back(id);
+        }
+    };
+
+    //queues a process on a core; the cores with nothing to run wake up when it is ready, to run or steal it
+    auto make_ready = [&](uint32_t id, uint32_t core, int since) {
+        scheduled_process_t& process = processes[id];
+        process.state = process_state_t::READY;
+        process.ready_since = since;
+        process.core = core;
+        cores[core].ready.push(id, process.priority, since);
+        row_changed(id);
+        for(core_t& other : cores) {
+            if(other.parked) {
+                other.wake = std::min(other.wake, since);
+            }
+        }
+    };
+
+    //moves every process whose I/O is done by 'now' to its core's run queue
+    auto collect_io = [&](int now) {
+        while(!waiting.empty() && std::get<0>(waiting.top()) <= now) {
+            auto [done, sequence, id] = waiting.top();
+            waiting.pop();
+            make_ready(id, processes[id].core, done);
+        }
+    };
+
+    //logs the time a core spent idle, once it has something to do again
+    auto end_idle = [&](uint32_t c) {
+        core_t& core = cores[c];
+        if(core.idle && core.clock > core.idle_since) {
+            log.idle(core.idle_since, core.clock - core.idle_since, multicore ? static_cast<int>(c) : -1);
+            core.metrics.idle += core.clock - core.idle_since;
+        }
+        core.idle = false;
+    };
+
+    //runs, on core 0, the ISR of every device completion due by its clock (queued I/O)
+    auto take_interrupts = [&]() {
+        int& current_time = cores[0].clock;
+        while(devices.pending() && devices.next_completion() <= current_time) {
+            end_idle(0);
+            uint32_t device;
+            io_request_t request = devices.complete(device);
+            const PCB& owner = processes[request.process].pcb;
+            current_time = intr_boilerplate(log, current_time, device, 10, owner);
+
+            log.emit(event_kind_t::IO_DONE, current_time, COMPLETION_ISR_TIME, owner, device);
+            current_time += COMPLETION_ISR_TIME;
+
+            log.emit(event_kind_t::IRET, current_time, 1, owner);
+            current_time += 1;
+            cores[0].metrics.interrupts++;
+            make_ready(request.process, processes[request.process].core, current_time);
+        }
+    };
+
+    //the next process for a core: from its own queue, or stolen from the core with the most queued
+    auto next_process = [&](uint32_t c) {
+        core_t& core = cores[c];
+        uint32_t own = core.ready.pop(core.clock);
+        if(own != NO_PROCESS) {
+            return own;
+        }
+        uint32_t victim = NO_CORE;
+        for(uint32_t other = 0; other < cores.size(); other++) {
+            if(other != c && cores[other].ready.ready_by(core.clock) && (victim == NO_CORE || cores[other].ready.size() > cores[victim].ready.size())) {
+                victim = other;
+            }
+        }
+        if(victim == NO_CORE) {
+            return NO_PROCESS;
+        }
+        core.metrics.steals++;
+        return cores[victim].ready.pop(core.clock);
+    };
+
+    //logs the system status, at once on one core (only the rows that changed, if the log
+    //keeps the table), once no core can log an earlier snapshot on several
+    auto log_process_table = [&](int at, opcode_t trace, int operand, std::string_view program) {
+        if(multicore) {
+            snapshots.hold(at, trace, operand, program, processes);
+        } else if(log_changes) {
+            //in the order of the table, which is the order the processes were created in
+            std::sort(changed.begin(), changed.end());
+            log.snapshot_changes(at, trace, operand, program);
+            for(uint32_t id : changed) {
+                log.snapshot_row(processes[id].pcb, processes[id].state);
+                processes[id].changed = false;
+            }
+            log.snapshot_end();
+            changed.clear();
+        } else {
+            write_process_table(log, at, trace, operand, program, processes);
+        }
+    };
+
+    //when a core has something to do next (INT_MAX if nothing will wake it)
+    auto core_time = [&](uint32_t c) {
+        const core_t& core = cores[c];
+        if(!core.parked) {
+            return core.clock;
+        }
+        int wake = core.wake;
+        if(queued_io && c == 0 && devices.pending()) {
+            wake = std::min(wake, std::max(core.clock, devices.next_completion()));
+        }
+        return wake;
+    };
+
+    int init_priority = program_priority(context.catalog, init.program_name);
+    build_view_branches(compiled, view_id);
+    processes.emplace_back(std::move(init), view_id, view_begin(compiled.views[view_id]), init_priority, time);
+    metrics.processes++;
+    make_ready(0, 0, time);
+
+    while(true) {
+        //the core with the earliest clock runs next, unless an I/O is done before it
+        uint32_t c = NO_CORE;
+        int when = INT_MAX;
+        for(uint32_t k = 0; k < cores.size(); k++) {
+            int t = core_time(k);
+            if(t < when) {
+                when = t;
+                c = k;
+            }
+        }
+        if(!waiting.empty() && std::get<0>(waiting.top()) <= when) {
+            collect_io(std::get<0>(waiting.top()));
+            continue;
+        }
+        //whatever a core does next ends after 'when', and so do the snapshots it logs
+        snapshots.release(log, when);
+        if(c == NO_CORE) {
+            break;
+        }
+
+        core_t& core = cores[c];
+        int& current_time = core.clock;
+        if(core.parked) {
+            core.parked = false;
+            core.wake = INT_MAX;
+            current_time = std::max(current_time, when);
+        }
+        if(queued_io && c == 0) {
+            take_interrupts();
+        }
+
+        if(core.running == NO_PROCESS) {
+            uint32_t next = next_process(c);
+            if(next == NO_PROCESS) {
+                //nothing to run until a process is ready somewhere (or a device is done)
+                core.parked = true;
+                core.wake = INT_MAX;
+                for(uint32_t k = 0; k < cores.size(); k++) {
+                    core.wake = std::min(core.wake, cores[k].ready.ready_at());
+                }
+                if(!core.idle) {
+                    core.idle = true;
+                    core.idle_since = current_time;
+                }
+                continue;
+            }
+            end_idle(c);
+
+            core.running = next;
+            scheduled_process_t& process = processes[core.running];
+            process.state = process_state_t::RUNNING;
+            process.core = c;
+            row_changed(core.running);
+            process.waited += current_time - process.ready_since;
+            if(process.first_run < 0) {
+                process.first_run = current_time;
+            }
+            core.quantum_left = config.quantum;
+            core.metrics.dispatches++;
+            metrics.context_switches++;
+            log.emit(event_kind_t::DISPATCH, current_time, 0, process.pcb, -1, multicore ? static_cast<int>(c) : -1);
+        }
+
+        uint32_t& running = core.running;
+        scheduled_process_t& process = processes[running];
+        const trace_view_t& view = compiled.views[process.view];
+        if(!view_valid(view, process.cursor)) {
+            process.state = process_state_t::TERMINATED;
+            process.completion = current_time;
+            row_changed(running);
+            metrics.completed++;
+            //the process gives its partition back, unless it shares its parent's (it never EXECed)
+            int freed = -1;
+            if(process.pcb.partition_number != -1 && machine.memory->owner(process.pcb.partition_number) == static_cast<int>(process.pcb.PID)) {
+                freed = process.pcb.partition_number;
+            }
+            log.emit(event_kind_t::TERMINATED, current_time, 0, process.pcb, -1, freed);
+            if(freed != -1) {
+                free_memory(machine, &process.pcb);
+            }
+            running = NO_PROCESS;
+            continue;
+        }
+
+        uint32_t index = process.cursor.index;
+        const instruction_t& instruction = compiled.programs[view.program].code()[index];
+        auto activity = instruction.op;
+        auto duration_intr = instruction.operand;
+        PCB& current = process.pcb;
+        PROFILE_OPCODE(activity);
+
+        if(activity == opcode_t::CPU) {
+            int left = process.burst_left > 0 ? process.burst_left : duration_intr;
+            int slice = round_robin ? std::min(left, core.quantum_left) : left;
+            if(queued_io && c == 0 && devices.pending()) {
+                //the burst stops where the next device interrupts it
+                slice = std::min(slice, devices.next_completion() - current_time);
+            }
+
+            log.emit(event_kind_t::CPU_BURST, current_time, slice, current);
+            current_time += slice;
+            core.metrics.user += slice;
+            left -= slice;
+
+            if(left > 0) {
+                process.burst_left = left;
+            } else {
+                process.burst_left = 0;
+                process.cursor.index++;
+            }
+
+            if(round_robin) {
+                core.quantum_left -= slice;
+                if(core.quantum_left <= 0) {
+                    collect_io(current_time);
+                    if(queued_io && c == 0) {
+                        take_interrupts();
+                    }
+                    if(!core.ready.ready_by(current_time)) {
+                        //nobody else wants this core: carry on with a new quantum
+                        core.quantum_left = config.quantum;
+                    } else {
+                        log.emit(event_kind_t::PREEMPTED, current_time, 0, current);
+                        metrics.preemptions++;
+                        make_ready(running, c, current_time);
+                        running = NO_PROCESS;
+                    }
+                }
+            }
+        } else if(activity == opcode_t::SYSCALL) {
+            process.cursor.index++;
+            current_time = intr_boilerplate(log, current_time, duration_intr, 10, current);
+
+            //the device works on its own; the process waits for it in the wait queue
+            if(queued_io) {
+                int done = devices.submit(duration_intr, running, current_time);
+                log.emit(event_kind_t::SYSCALL_WAIT, current_time, 0, current, duration_intr, done - current_time);
+            } else {
+                int delay = delays[duration_intr];
+                log.emit(event_kind_t::SYSCALL_WAIT, current_time, 0, current, duration_intr, delay);
+                waiting.push({current_time + delay, io_sequence++, running});
+            }
+            process.state = process_state_t::WAITING;
+            row_changed(running);
+
+            log.emit(event_kind_t::IRET, current_time, 1, current);
+            current_time += 1;
+            running = NO_PROCESS;
+        } else if(activity == opcode_t::END_IO) {
+            process.cursor.index++;
+            if(queued_io) {
+                //the device's interrupt already ran this ISR
+                continue;
+            }
+            current_time = intr_boilerplate(log, current_time, duration_intr, 10, current);
+
+            log.emit(event_kind_t::ENDIO_ISR, current_time, delays[duration_intr], current);
+            current_time += delays[duration_intr];
+
+            log.emit(event_kind_t::IRET, current_time, 1, current);
+            current_time += 1;
+        } else if(activity == opcode_t::FORK) {
+            current_time = intr_boilerplate(log, current_time, 2, 10, current);
+
+            log.emit(event_kind_t::CLONE_PCB, current_time, duration_intr, current);
+            current_time += duration_intr;
+
+            log.emit(event_kind_t::SCHEDULER_CALLED, current_time, 0, current);
+
+            log.emit(event_kind_t::IRET, current_time, 1, current);
+            current_time += 1;
+
+            //the child runs its branch of the view, the parent continues after it
+            const fork_branch_t& branch = view.forks.at(index);
+            process.cursor = branch.parent_resume;
+            process.cursor.index++;
+
+            uint32_t child_view = branch.child_view;
+            build_view_branches(compiled, child_view);
+            PCB child(machine.next_pid++, current.PID, current.program_name, current.size, current.partition_number);
+            int child_priority = process.priority;
+
+            //(this invalidates 'process' and 'current')
+            processes.emplace_back(std::move(child), child_view, view_begin(compiled.views[child_view]), child_priority, current_time);
+            metrics.processes++;
+            make_ready(static_cast<uint32_t>(processes.size() - 1), c, current_time);
+
+            log_process_table(current_time - 1, opcode_t::FORK, duration_intr, {});
+        } else if(activity == opcode_t::EXEC) {
+            process.cursor.index++;
+            current_time = intr_boilerplate(log, current_time, 3, 10, current);
+
+            const uint32_t program_id = compiled.programs[view.program].exec_target(instruction);
+            const program_image_t& program = compiled.programs[program_id];
+            const std::string& program_name = program.program_name;
+
+            if(program_sizes[program_id] < 0) {
+                std::cerr << "ERROR! " << program_name << " is not in the external files table" << std::endl;
+                log.emit(event_kind_t::EXEC_FAILED, current_time, duration_intr, current, -1, -1, program_name);
+                current_time += duration_intr;
+
+                log.emit(event_kind_t::IRET, current_time, 1, current);
+                current_time += 1;
+                continue;
+            }
+            unsigned int program_size = program_sizes[program_id];
+
+            log.emit(event_kind_t::PROGRAM_SIZE, current_time, duration_intr, current, -1, program_size);
+            current_time += duration_intr;
+
+            int loading_time = program_size * 15;
+            log.emit(event_kind_t::LOAD_PROGRAM, current_time, loading_time, current);
+            current_time += loading_time;
+
+            log.emit(event_kind_t::MARK_PARTITION, current_time, 3, current);
+            current_time += 3;
+
+            if(current.partition_number != -1) {
+                free_memory(machine, &current);
+            }
+            current.program_name = program_name;
+            current.size = program_size;
+            if(!allocate_memory(machine, &current)) {
+                std::cerr << "ERROR! Memory allocation failed for " << program_name << std::endl;
+            }
+            process.priority = program_priority(context.catalog, program_name);
+            row_changed(running);
+
+            log.emit(event_kind_t::UPDATE_PCB, current_time, 6, current);
+            current_time += 6;
+
+            log.emit(event_kind_t::SCHEDULER_CALLED, current_time, 0, current);
+
+            log.emit(event_kind_t::IRET, current_time, 1, current);
+            current_time += 1;
+
+            log_process_table(current_time - 1, opcode_t::EXEC, duration_intr, program_name);
+
+            //the new program replaces the rest of the current one
+            process.view = program_id;
+            build_view_branches(compiled, process.view);
+            process.cursor = view_begin(compiled.views[process.view]);
+            process.burst_left = 0;
+        } else {
+            process.cursor.index++;
+        }
+    }
+
+    //the run ends with the last thing a core did; the cores are idle from then on
+    int end = time;
+    for(const core_t& core : cores) {
+        end = std::max(end, core.idle ? core.idle_since : core.clock);
+    }
+    for(core_t& core : cores) {
+        if(core.idle) {
+            core.metrics.idle += end - core.idle_since;
+        }
+        metrics.idle += core.metrics.idle;
+        metrics.cores.push_back(core.metrics);
+    }
+
+    metrics.end = end;
+    if(queued_io) {
+        metrics.devices = devices.used();
+    }
+    for(const auto& process : processes) {
+        if(process.state == process_state_t::TERMINATED) {
+            metrics.turnaround += process.completion - process.arrival;
+            metrics.response += process.first_run - process.arrival;
+            metrics.waiting += process.waited;
+        }
+    }
+
+    return end;
+}
+
+//Prints the throughput, turnaround and wait times of a scheduled run
+void print_scheduler_metrics(std::ostream& out, const scheduler_metrics_t& metrics) {
+    int64_t makespan = metrics.end - metrics.start;
+    double completed = metrics.completed ? static_cast<double>(metrics.completed) : 1.0;
+
+    int64_t capacity = makespan * std::max<int64_t>(metrics.cores.size(), 1);   //!< time the cores could have been busy
+
+    out << "Scheduler: " << scheduling_policy_name(metrics.config.policy);
+    if(metrics.config.policy == scheduling_policy_t::ROUND_ROBIN) {
+        out << " (quantum " << metrics.config.quantum << " ms)";
+    }
+    if(metrics.cores.size() > 1) {
+        out << " on " << metrics.cores.size() << " cores";
+    }
+    out << std::endl;
+
+    out << std::fixed << std::setprecision(1);
+    out << "  processes: " << metrics.completed << " of " << metrics.processes << " completed, "
+        << metrics.context_switches << " dispatches, " << metrics.preemptions << " preemptions" << std::endl;
+    out << "  makespan: " << makespan << " ms, CPU utilization: "
+        << (capacity ? 100.0 * (capacity - metrics.idle) / capacity : 0.0) << "%" << std::endl;
+    out << "  throughput: " << (makespan ? 1000.0 * metrics.completed / makespan : 0.0) << " processes/s" << std::endl;
+    out << "  average turnaround: " << metrics.turnaround / completed << " ms, wait: "
+        << metrics.waiting / completed << " ms, response: " << metrics.response / completed << " ms" << std::endl;
+    if(metrics.cores.size() > 1) {
+        for(size_t c = 0; c < metrics.cores.size(); c++) {
+            const core_metrics_t& core = metrics.cores[c];
+            int64_t kernel = makespan - core.idle - core.user;
+            out << "  core " << c << ": " << (makespan ? 100.0 * (makespan - core.idle) / makespan : 0.0) << "% busy ("
+                << (makespan ? 100.0 * core.user / makespan : 0.0) << "% user, " << (makespan ? 100.0 * kernel / makespan : 0.0) << "% kernel), "
+                << core.dispatches << " dispatches, " << core.steals << " steals, " << core.interrupts << " interrupts" << std::endl;
+        }
+    }
+    out << std::defaultfloat;
+    if(metrics.config.io == io_model_t::QUEUED) {
+        out << "  queued I/O: " << metrics.devices.size() << " devices used" << std::endl;
+        print_device_metrics(out, metrics.devices, makespan);
+    }
+}
+
+#endif
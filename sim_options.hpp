@@ -0,0 +1,286 @@
+#ifndef SIM_OPTIONS_HPP_
+#define SIM_OPTIONS_HPP_
+
+#include<charconv>
+
+#include "interrupts_101259994_101108918.hpp"
+#include "memory_allocator.hpp"
+#include "scheduler.hpp"
+#include "binary_trace.hpp"
+#include "status_delta.hpp"
+
+//Reads a whole option value as a number greater than 0
+bool parse_positive(std::string_view value, int& number) {
+    auto result = std::from_chars(value.data(), value.data() + value.size(), number);
+    return result.ec == std::errc() && result.ptr == value.data() + value.size() && number > 0;
+}
+
+//Which logs a run writes
+enum class log_format_t {
+    TEXT,       //!< execution.txt and system_status.txt
+    COLUMNAR,   //!< execution.simlog (see columnar_event_log_t)
+    BOTH
+};
+
+bool parse_log_format(std::string_view name, log_format_t& format) {
+    if(name == "text") {
+        format = log_format_t::TEXT;
+    } else if(name == "columnar") {
+        format = log_format_t::COLUMNAR;
+    } else if(name == "both") {
+        format = log_format_t::BOTH;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+//How a run writes the system status log
+enum class status_format_t {
+    TEXT,       //!< system_status.txt, a full table per snapshot
+    DELTA       //!< system_status.delta (see delta_status_log_t)
+};
+
+bool parse_status_format(std::string_view name, status_format_t& format) {
+    if(name == "text") {
+        format = status_format_t::TEXT;
+    } else if(name == "delta") {
+        format = status_format_t::DELTA;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+//Settings given on the command line after the four input files, as --name=value
+struct sim_options_t {
+    allocation_policy_t         allocation_policy = allocation_policy_t::BEST_FIT;
+    std::vector<unsigned int>   partition_sizes = default_partition_sizes;
+    bool                        scheduled = false;  //!< run under the scheduler instead of FORK-runs-the-child-first
+    scheduler_config_t          scheduler;
+    log_format_t                log_format = log_format_t::TEXT;
+    status_format_t             status_format = status_format_t::TEXT;
+};
+
+/**
+ * \brief read the simulator's options
+ *
+ * Supported options:
+ *  --allocator=first|best|worst|buddy  how memory partitions are handed out (default: best)
+ *  --memory-layout=<file>              partition sizes, one per line (default: 40, 25, 15, 10, 8, 2)
+ *  --partitions=<count>                a generated layout of 'count' partitions instead (at most MAX_PARTITIONS)
+ *  --scheduler=fcfs|priority|rr        run the processes under a scheduler (see schedule_trace)
+ *  --quantum=<ms>                      the round robin quantum (default: 50)
+ *  --io=ideal|queued                   how the devices serve SYSCALLs under a scheduler (default: ideal)
+ *  --cores=<count>                     how many CPUs run the processes under a scheduler (default: 1)
+ *  --log-format=text|columnar|both     the text logs, the columnar log or both (default: text)
+ *  --status-format=text|delta          the system status as full tables or as deltas (default: text)
+ *
+ * @param arguments the options, as given on the command line
+ * @return the options, with defaults for the ones not given
+ * @throws std::runtime_error if an option is unknown or has an invalid value
+ *
+ */
+sim_options_t read_options(const std::vector<std::string_view>& arguments) {
+    sim_options_t options;
+
+    for(std::string_view option : arguments) {
+        size_t equals = option.find('=');
+        std::string_view name = option.substr(0, equals);
+        std::string value(equals == std::string_view::npos ? std::string_view() : option.substr(equals + 1));
+
+        if(name == "--allocator") {
+            if(!parse_allocation_policy(value, options.allocation_policy)) {
+                throw std::runtime_error("Unknown allocator '" + value + "' (expected first, best, worst or buddy)");
+            }
+        } else if(name == "--memory-layout") {
+            options.partition_sizes = load_partition_layout(value);
+        } else if(name == "--partitions") {
+            int count = 0;
+            if(!parse_positive(value, count) || count > MAX_PARTITIONS) {
+                throw std::runtime_error("Invalid partition count '" + value + "' (expected 1 to " + std::to_string(MAX_PARTITIONS) + ")");
+            }
+            options.partition_sizes = generate_partition_layout(count);
+        } else if(name == "--scheduler") {
+            if(!parse_scheduling_policy(value, options.scheduler.policy)) {
+                throw std::runtime_error("Unknown scheduler '" + value + "' (expected fcfs, priority or rr)");
+            }
+            options.scheduled = true;
+        } else if(name == "--quantum") {
+            if(!parse_positive(value, options.scheduler.quantum)) {
+                throw std::runtime_error("Invalid quantum '" + value + "'");
+            }
+        } else if(name == "--io") {
+            if(!parse_io_model(value, options.scheduler.io)) {
+                throw std::runtime_error("Unknown I/O model '" + value + "' (expected ideal or queued)");
+            }
+        } else if(name == "--cores") {
+            int cores = 0;
+            if(!parse_positive(value, cores)) {
+                throw std::runtime_error("Invalid core count '" + value + "'");
+            }
+            options.scheduler.cores = cores;
+        } else if(name == "--log-format") {
+            if(!parse_log_format(value, options.log_format)) {
+                throw std::runtime_error("Unknown log format '" + value + "' (expected text, columnar or both)");
+            }
+        } else if(name == "--status-format") {
+            if(!parse_status_format(value, options.status_format)) {
+                throw std::runtime_error("Unknown status format '" + value + "' (expected text or delta)");
+            }
+        } else {
+            throw std::runtime_error("Unknown option: " + std::string(option));
+        }
+    }
+
+    if((options.scheduler.io != io_model_t::IDEAL || options.scheduler.cores > 1) && !options.scheduled) {
+        throw std::runtime_error("--io and --cores need a scheduler (--scheduler=fcfs|priority|rr)");
+    }
+
+    return options;
+}
+
+/**
+ * \brief parse the optional CLI arguments
+ *
+ * Everything after the four input files (see read_options). Exits with an error
+ * message if an option is not valid.
+ *
+ * @param argc number of command line arguments
+ * @param argv the command line arguments
+ * @return the options, with defaults for the ones not given
+ *
+ */
+sim_options_t parse_options(int argc, char** argv) {
+    std::vector<std::string_view> arguments(argv + std::min(argc, 5), argv + argc);
+    try {
+        return read_options(arguments);
+    } catch(const std::runtime_error& error) {
+        std::cerr << "Error: " << error.what() << std::endl;
+        exit(1);
+    }
+}
+
+/**
+ * \brief run one simulation
+ *
+ * Loads init into the machine's memory and runs the compiled trace with the
+ * engine the options select. Everything the run changes is in 'machine' (and in
+ * 'compiled', whose views are resolved as they first run), so runs with their
+ * own machines do not affect each other.
+ *
+ * @param machine the memory and PID counter of this run
+ * @param compiled the compiled trace
+ * @param context the vector, device and external files tables
+ * @param options the command line options
+ * @param log where the execution events and system status snapshots go
+ * @param metrics filled with the scheduler's metrics (scheduled runs only)
+ * @return the time at the end
+ *
+ */
+int run_simulation(machine_t& machine, compiled_trace_t& compiled, const simulation_context_t& context, const sim_options_t& options, event_log_t& log, scheduler_metrics_t& metrics) {
+    PROFILE_RUN();
+    //Make initial PCB (notice how partition is not assigned yet)
+    PCB current(0, -1, "init", 1, -1);
+    //Update memory (partition is assigned here)
+    if(!allocate_memory(machine, &current)) {
+        std::cerr << "ERROR! Memory allocation failed!" << std::endl;
+    }
+
+    if(options.scheduled) {
+        return schedule_trace(compiled, ROOT_PROGRAM, 0, context, machine, std::move(current), options.scheduler, log, metrics);
+    }
+    return simulate_trace(compiled, ROOT_PROGRAM, 0, context, machine, std::move(current), log);
+}
+
+//The log files of one run, in the formats the options ask for: '<prefix>execution.txt'
+//and '<prefix>system_status.txt' for text, '<prefix>execution.simlog' for columnar,
+//and '<prefix>system_status.delta' for a delta status log (which then takes every
+//system status snapshot, in place of the other logs)
+struct run_logs_t {
+    std::unique_ptr<file_sink_t>            execution;
+    std::unique_ptr<output_sink_t>          system_status;
+    std::unique_ptr<file_sink_t>            events;
+    std::unique_ptr<file_sink_t>            status_delta;
+    std::unique_ptr<text_event_log_t>       text;
+    std::unique_ptr<columnar_event_log_t>   columnar;
+    std::unique_ptr<tee_event_log_t>        both;
+    std::unique_ptr<delta_status_log_t>     delta;
+    event_log_t*                            log = nullptr;  //!< where the simulation logs to
+
+    //Opens the files. Returns false if one of them cannot be written.
+    bool open(log_format_t format, status_format_t status, const std::string& prefix, const vector_table_t& vectors) {
+        if(format != log_format_t::COLUMNAR) {
+            execution = std::make_unique<file_sink_t>(prefix + "execution.txt");
+            if(status == status_format_t::TEXT) {
+                auto file = std::make_unique<file_sink_t>(prefix + "system_status.txt");
+                if(!file->is_open()) {
+                    return false;
+                }
+                system_status = std::move(file);
+            } else {
+                system_status = std::make_unique<null_sink_t>();
+            }
+            if(!execution->is_open()) {
+                return false;
+            }
+            text = std::make_unique<text_event_log_t>(*execution, *system_status, vectors);
+            log = text.get();
+        }
+        if(format != log_format_t::TEXT) {
+            events = std::make_unique<file_sink_t>(prefix + "execution.simlog");
+            if(!events->is_open()) {
+                return false;
+            }
+            columnar = std::make_unique<columnar_event_log_t>(*events);
+            log = columnar.get();
+        }
+        if(format == log_format_t::BOTH) {
+            both = std::make_unique<tee_event_log_t>(*text, *columnar);
+            log = both.get();
+        }
+        if(status == status_format_t::DELTA) {
+            status_delta = std::make_unique<file_sink_t>(prefix + "system_status.delta");
+            if(!status_delta->is_open()) {
+                return false;
+            }
+            delta = std::make_unique<delta_status_log_t>(*log, *status_delta);
+            log = delta.get();
+        }
+        return true;
+    }
+
+    //Finishes the logs and closes the files
+    void close() {
+        if(columnar) {
+            columnar->finish();
+        }
+        if(delta) {
+            delta->finish();
+        }
+        if(system_status) {
+            system_status->flush();
+        }
+        for(file_sink_t* file : {execution.get(), events.get(), status_delta.get()}) {
+            if(file) {
+                file->close();
+            }
+        }
+    }
+
+    //The names of the files written, for the user
+    std::string describe(const std::string& prefix) const {
+        std::string files;
+        for(const auto& [sink, name] : {std::pair<const void*, const char*>{execution.get(), "execution.txt"},
+                                        {delta ? nullptr : system_status.get(), "system_status.txt"},
+                                        {events.get(), "execution.simlog"},
+                                        {status_delta.get(), "system_status.delta"}}) {
+            if(sink) {
+                files += (files.empty() ? "" : " and ") + prefix + name;
+            }
+        }
+        return files;
+    }
+};
+
+#endif
@@ -0,0 +1,303 @@
+#ifndef SIMULATOR_HPP_
+#define SIMULATOR_HPP_
+
+#include "interrupts_101259994_101108918.hpp"
+#include "compiled_trace.hpp"
+#include "output_sink.hpp"
+#include "event_log.hpp"
+
+//A process on the simulator's stack: the view it runs, where it is in it and its PCB
+struct process_frame_t {
+    uint32_t        view;
+    view_cursor_t   cursor;
+    uint32_t        pcb;
+};
+
+//Size of every compiled program, looked up in the catalog by name once so that
+//EXEC can index it by program id. Programs that are not listed get -1.
+std::vector<int64_t> link_program_sizes(const compiled_trace_t& compiled, const program_catalog_t& catalog) {
+    std::vector<int64_t> program_sizes(compiled.programs.size(), -1);
+
+    for(size_t id = 0; id < compiled.programs.size(); id++) {
+        unsigned int size;
+        if(find_program(catalog, compiled.programs[id].program_name, size)) {
+            program_sizes[id] = size;
+        }
+    }
+
+    return program_sizes;
+}
+
+//Checks that every device and vector the compiled programs use is in the tables,
+//so that the engines can index them directly. Throws std::runtime_error if not.
+void check_table_numbers(const compiled_trace_t& compiled, const simulation_context_t& context) {
+    const size_t devices = context.delays.size();
+    const size_t vectors = context.vectors.addresses.size();
+
+    for(const program_image_t& program : compiled.programs) {
+        for(const instruction_t& instruction : program.code()) {
+            int number;
+            if(instruction.op == opcode_t::SYSCALL || instruction.op == opcode_t::END_IO) {
+                number = instruction.operand;
+                if(number < 0 || static_cast<size_t>(number) >= devices) {
+                    throw std::runtime_error(program.program_name + " uses device " + std::to_string(number)
+                                             + ", but the device table has " + std::to_string(devices) + " devices");
+                }
+            } else if(instruction.op == opcode_t::FORK) {
+                number = 2;
+            } else if(instruction.op == opcode_t::EXEC) {
+                number = 3;
+            } else {
+                continue;
+            }
+            if(static_cast<size_t>(number) >= vectors) {
+                throw std::runtime_error(program.program_name + " uses vector " + std::to_string(number)
+                                         + ", but the vector table has " + std::to_string(vectors) + " vectors");
+            }
+        }
+    }
+}
+
+//Everything a run of simulate_trace has in flight besides the machine: the
+//simulated time and the stack of processes. A copy, with a copy of the machine,
+//is a checkpoint the run can be resumed from (see resume_trace).
+struct simulator_state_t {
+    int                             current_time = 0;
+    std::vector<PCB>                pcbs;           //!< PCB of every process on the stack
+    std::vector<process_frame_t>    processes;
+    uint64_t                        steps = 0;      //!< instructions run so far
+};
+
+//Watches a run of resume_trace, instruction by instruction
+struct simulation_observer_t {
+    virtual ~simulation_observer_t() = default;
+
+    //Called before each instruction runs, with the state it runs from and the id of its program
+    virtual void before_instruction(const simulator_state_t& state, const machine_t& machine, const instruction_t& instruction, uint32_t program) = 0;
+};
+
+//The state of a run that is about to start the given view as process 'init'
+simulator_state_t start_trace(compiled_trace_t& compiled, uint32_t view_id, int time, PCB init) {
+    simulator_state_t state;
+    state.current_time = time;
+    state.pcbs.push_back(std::move(init));
+    build_view_branches(compiled, view_id);
+    state.processes.push_back({view_id, view_begin(compiled.views[view_id]), 0});
+    return state;
+}
+
+/**
+ * \brief run a compiled trace from a given state
+ *
+ * A FORK suspends the parent until the child has run to completion and an EXEC
+ * replaces the running program, so the running processes always form a stack:
+ * each entry holds only the view being run, the position in it and the index of
+ * its PCB. Nothing is copied per FORK or EXEC, and the depth of the fork chain is
+ * not limited by the native stack.
+ *
+ * The state is either a fresh one (start_trace) or a copy taken by an observer,
+ * which resumes the run exactly where the copy was made, as long as the machine
+ * is in the state it was in at that point too.
+ *
+ * @param compiled the compiled trace (child views are resolved into it as they first run)
+ * @param state the time and the processes to run; updated as they run
+ * @param context the vector, device and external files tables
+ * @param machine the memory and PID counter the run allocates from
+ * @param log where the execution events and system status snapshots go, as they happen
+ * @param observer called before every instruction (none if null)
+ * @return the time at the end
+ *
+ */
+int resume_trace(compiled_trace_t& compiled, simulator_state_t& state, const simulation_context_t& context, machine_t& machine, event_log_t& log, simulation_observer_t* observer = nullptr) {
+    PROFILE_SCOPE(phase_t::SIMULATE);
+
+    const std::vector<int>& delays = context.delays;
+    int& current_time = state.current_time;
+    std::vector<PCB>& pcbs = state.pcbs;
+    std::vector<process_frame_t>& processes = state.processes;
+
+    const std::vector<int64_t> program_sizes = link_program_sizes(compiled, context.catalog);
+
+    //run the instructions of the process on top of the stack until every process is done
+    while(!processes.empty()) {
+        process_frame_t& process = processes.back();
+        const trace_view_t& view = compiled.views[process.view];
+        if(!view_valid(view, process.cursor)) {
+            //the process is done: its parent (if any) continues
+            processes.pop_back();
+            pcbs.pop_back();
+            continue;
+        }
+
+        const instruction_t& instruction = compiled.programs[view.program].code()[process.cursor.index];
+        if(observer) {
+            observer->before_instruction(state, machine, instruction, view.program);
+        }
+        state.steps++;
+        uint32_t index = process.cursor.index++;
+        auto activity = instruction.op;
+        auto duration_intr = instruction.operand;
+        PCB& current = pcbs[process.pcb];
+        PROFILE_OPCODE(activity);
+
+        if(activity == opcode_t::CPU) { //As per Assignment 1
+            log.emit(event_kind_t::CPU_BURST, current_time, duration_intr, current);
+            current_time += duration_intr;
+        } else if(activity == opcode_t::SYSCALL) { //As per Assignment 1
+            current_time = intr_boilerplate(log, current_time, duration_intr, 10, current);
+
+            log.emit(event_kind_t::SYSCALL_ISR, current_time, delays[duration_intr], current);
+            current_time += delays[duration_intr];
+
+            log.emit(event_kind_t::IRET, current_time, 1, current);
+            current_time += 1;
+        } else if(activity == opcode_t::END_IO) {
+            current_time = intr_boilerplate(log, current_time, duration_intr, 10, current);
+
+            log.emit(event_kind_t::ENDIO_ISR, current_time, delays[duration_intr], current);
+            current_time += delays[duration_intr];
+
+            log.emit(event_kind_t::IRET, current_time, 1, current);
+            current_time += 1;
+        } else if(activity == opcode_t::FORK) {
+            current_time = intr_boilerplate(log, current_time, 2, 10, current);
+
+            ///////////////////////////////////////////////////////////////////////////////////////////
+            // FORK ISR implementation
+            log.emit(event_kind_t::CLONE_PCB, current_time, duration_intr, current);
+            current_time += duration_intr;
+
+            log.emit(event_kind_t::SCHEDULER_CALLED, current_time, 0, current);
+
+            log.emit(event_kind_t::IRET, current_time, 1, current);
+            current_time += 1;
+
+            PCB child(machine.next_pid++, current.PID, current.program_name, current.size, current.partition_number);
+
+            // Output system status
+            log.snapshot(current_time - 1, opcode_t::FORK, duration_intr, {});
+            log.snapshot_row(child, process_state_t::RUNNING);
+            log.snapshot_row(current, process_state_t::WAITING);
+            log.snapshot_end();
+
+
+
+            ///////////////////////////////////////////////////////////////////////////////////////////
+
+            //The branch table (built when the trace was compiled) gives 2 things:
+            // * The view holding the trace of the child (and only the child, skip parent)
+            // * Where the parent is supposed to start executing from
+            const fork_branch_t& branch = view.forks.at(index);
+
+            //the parent continues after the child is done
+            process.cursor = branch.parent_resume;
+            process.cursor.index++;
+
+            ///////////////////////////////////////////////////////////////////////////////////////////
+            //run the child on top of the parent (this invalidates 'process' and 'current')
+            uint32_t child_view = branch.child_view;
+            build_view_branches(compiled, child_view);
+            pcbs.push_back(std::move(child));
+            processes.push_back({child_view, view_begin(compiled.views[child_view]), static_cast<uint32_t>(pcbs.size() - 1)});
+
+            ///////////////////////////////////////////////////////////////////////////////////////////
+
+
+        } else if(activity == opcode_t::EXEC) {
+            current_time = intr_boilerplate(log, current_time, 3, 10, current);
+
+            ///////////////////////////////////////////////////////////////////////////////////////////
+            // EXEC ISR implementation
+            const uint32_t program_id = compiled.programs[view.program].exec_target(instruction);
+            const program_image_t& program = compiled.programs[program_id];
+            const std::string& program_name = program.program_name;
+
+            // Step 1: Get size of the new executable (from the catalog, by program id)
+            if(program_sizes[program_id] < 0) {
+                // Not in the external files table: the EXEC fails and the process carries on
+                std::cerr << "ERROR! " << program_name << " is not in the external files table" << std::endl;
+                log.emit(event_kind_t::EXEC_FAILED, current_time, duration_intr, current, -1, -1, program_name);
+                current_time += duration_intr;
+
+                log.emit(event_kind_t::IRET, current_time, 1, current);
+                current_time += 1;
+                continue;
+            }
+            unsigned int program_size = program_sizes[program_id];
+
+            log.emit(event_kind_t::PROGRAM_SIZE, current_time, duration_intr, current, -1, program_size);
+            current_time += duration_intr;
+
+            // Step 2: Calculate loading time (15 ms per MB)
+            int loading_time = program_size * 15;
+            log.emit(event_kind_t::LOAD_PROGRAM, current_time, loading_time, current);
+            current_time += loading_time;
+
+            // Step 3: Mark partition as occupied (random time 1-10ms, let's use 3)
+            log.emit(event_kind_t::MARK_PARTITION, current_time, 3, current);
+            current_time += 3;
+
+            // Step 4: Update PCB (random time 1-10ms, let's use 6)
+            // Free old memory if process already had a partition
+            if(current.partition_number != -1) {
+                free_memory(machine, &current);
+            }
+
+            // Update PCB with new program info
+            current.program_name = program_name;
+            current.size = program_size;
+
+            // Allocate memory for the new program
+            if(!allocate_memory(machine, &current)) {
+                std::cerr << "ERROR! Memory allocation failed for " << program_name << std::endl;
+            }
+
+            log.emit(event_kind_t::UPDATE_PCB, current_time, 6, current);
+            current_time += 6;
+
+            log.emit(event_kind_t::SCHEDULER_CALLED, current_time, 0, current);
+
+            log.emit(event_kind_t::IRET, current_time, 1, current);
+            current_time += 1;
+
+            // Output system status
+            log.snapshot(current_time - 1, opcode_t::EXEC, duration_intr, program_name);
+            log.snapshot_row(current, process_state_t::RUNNING);
+            log.snapshot_end();
+
+            ///////////////////////////////////////////////////////////////////////////////////////////
+
+            // Now execute the new program (compiled together with the trace).
+            // It replaces the rest of the current one, whose view is never resumed.
+            ///////////////////////////////////////////////////////////////////////////////////////////
+            process.view = program_id;
+            build_view_branches(compiled, process.view);
+            process.cursor = view_begin(compiled.views[process.view]);
+            ///////////////////////////////////////////////////////////////////////////////////////////
+        }
+    }
+
+    return current_time;
+}
+
+/**
+ * \brief run a compiled trace
+ *
+ * Runs the given view as process 'init', from start to end (see resume_trace).
+ *
+ * @param compiled the compiled trace (child views are resolved into it as they first run)
+ * @param view_id the view to run first
+ * @param time the simulated time to start at
+ * @param context the vector, device and external files tables
+ * @param machine the memory and PID counter the run allocates from
+ * @param init the PCB of the process that runs the view
+ * @param log where the execution events and system status snapshots go, as they happen
+ * @return the time at the end
+ *
+ */
+int simulate_trace(compiled_trace_t& compiled, uint32_t view_id, int time, const simulation_context_t& context, machine_t& machine, PCB init, event_log_t& log) {
+    simulator_state_t state = start_trace(compiled, view_id, time, std::move(init));
+    return resume_trace(compiled, state, context, machine, log);
+}
+
+#endif
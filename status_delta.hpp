@@ -0,0 +1,514 @@
+#ifndef STATUS_DELTA_HPP_
+#define STATUS_DELTA_HPP_
+
+#include<algorithm>
+
+#include "event_log.hpp"
+
+//A delta status log (see delta_status_log_t): the system status snapshots of a run,
+//each stored as the changes from the one before, with a full checkpoint every
+//STATUS_CHECKPOINT_INTERVAL snapshots. Everything is 4-byte words in the byte order
+//of the machine that wrote it:
+//
+//  header      STATUS_DELTA_MAGIC, byte order, version
+//  snapshots   a snapshot record and its operations, one after the other:
+//      DELTA_SNAPSHOT / DELTA_CHECKPOINT   tag | opcode << 8, time, operand, program, operation count
+//      DELTA_COPY                          tag, first row, row count: rows of the previous snapshot, as they were
+//      DELTA_ROW                           tag | state << 8, PID, partition, program, size: a new or changed row
+//  names       count, then each name as a length and the bytes (padded)
+//  index       count, then the time and offset of every checkpoint
+//  footer      offsets of the names and of the index, snapshot count, STATUS_DELTA_MAGIC
+//
+//A checkpoint only holds DELTA_ROWs, so reading can start at any of them.
+#define STATUS_DELTA_MAGIC          "SIMDELTA"
+#define STATUS_DELTA_VERSION        1
+#define STATUS_DELTA_BYTE_ORDER     0x01020304u
+#define STATUS_CHECKPOINT_INTERVAL  64      //!< snapshots from one checkpoint to the next
+
+enum status_delta_tag_t : uint8_t {
+    DELTA_SNAPSHOT = 1,
+    DELTA_CHECKPOINT,
+    DELTA_COPY,
+    DELTA_ROW
+};
+
+struct status_delta_header_t {
+    char        magic[8];
+    uint32_t    byte_order;
+    uint32_t    version;
+};
+
+struct status_delta_footer_t {
+    uint64_t    names_offset;
+    uint64_t    index_offset;
+    uint32_t    snapshots;
+    uint32_t    reserved;
+    char        magic[8];
+};
+
+struct status_checkpoint_t {
+    int32_t     time;
+    uint32_t    reserved;
+    uint64_t    offset;     //!< of the checkpoint's snapshot record
+};
+
+//A row of a snapshot, with the program as a name id
+struct status_row_t {
+    int32_t     pid;
+    int32_t     partition;
+    uint32_t    program;
+    uint32_t    size;
+    uint32_t    state;
+
+    bool operator==(const status_row_t& other) const {
+        return pid == other.pid && partition == other.partition && program == other.program
+            && size == other.size && state == other.state;
+    }
+};
+
+static_assert(sizeof(status_delta_header_t) == 16 && sizeof(status_delta_footer_t) == 32
+              && sizeof(status_checkpoint_t) == 16, "unexpected status delta record size");
+
+/**
+ * Writes the system status snapshots as a delta status log (see STATUS_DELTA_MAGIC)
+ * and passes the events on to another log. Each snapshot is compared with the one
+ * before: rows that did not change are stored as runs to copy, so a snapshot of
+ * thousands of processes of which one changed state costs a few words instead of
+ * a whole table. Call finish() once the run is done: the log is not complete before.
+ *
+ * The log keeps the table, so a snapshot can also be given as the rows that changed
+ * (see event_log_t::snapshot_changes), which the scheduler does: it then costs time
+ * in the number of changes rather than the size of the table, apart from every
+ * checkpoint and the snapshots after processes ended (whose rows are taken out).
+ * Either way, the same bytes are written.
+ */
+struct delta_status_log_t : event_log_t {
+    event_log_t&                                    events;
+    output_sink_t&                                  output;
+    uint64_t                                        offset = 0;         //!< bytes written so far
+    uint32_t                                        snapshots = 0;
+    std::array<int32_t, 4>                          snapshot_fields{};  //!< tag | opcode << 8, time, operand, program
+    std::vector<status_row_t>                       previous;
+    std::vector<status_row_t>                       current;
+    std::vector<int32_t>                            previous_row;       //!< by PID: its row in 'previous', or -1
+    bool                                            changes_only = false;   //!< 'current' holds only the rows that changed
+    std::vector<uint32_t>                           operations;
+    std::vector<status_checkpoint_t>                checkpoints;
+    std::deque<std::string>                         names;              //!< by id (a deque, so the keys below stay valid)
+    std::unordered_map<std::string_view, uint32_t>  name_ids;
+    bool                                            finished = false;
+
+    delta_status_log_t(event_log_t& _events, output_sink_t& _output): events(_events), output(_output) {
+        status_delta_header_t header{};
+        std::memcpy(header.magic, STATUS_DELTA_MAGIC, sizeof(header.magic));
+        header.byte_order = STATUS_DELTA_BYTE_ORDER;
+        header.version = STATUS_DELTA_VERSION;
+        write_bytes(&header, sizeof(header));
+    }
+
+    ~delta_status_log_t() override {
+        finish();
+    }
+
+    void event(const event_t& event, std::string_view program = {}) override {
+        events.event(event, program);
+    }
+
+    void snapshot(int time, opcode_t trace, int operand, std::string_view program) override {
+        PROFILE_SCOPE(phase_t::LOG);
+        bool checkpoint = snapshots % STATUS_CHECKPOINT_INTERVAL == 0;
+        uint32_t name = trace == opcode_t::EXEC ? intern(program) : NO_INDEX;
+        snapshot_fields = {(checkpoint ? DELTA_CHECKPOINT : DELTA_SNAPSHOT) | static_cast<int32_t>(trace) << 8, time, operand, static_cast<int32_t>(name)};
+        if(checkpoint) {
+            checkpoints.push_back({time, 0, offset});
+        }
+        current.clear();
+        changes_only = false;
+    }
+
+    bool keeps_table() const override {
+        return true;
+    }
+
+    void snapshot_changes(int time, opcode_t trace, int operand, std::string_view program) override {
+        snapshot(time, trace, operand, program);
+        changes_only = true;
+    }
+
+    void snapshot_row(int pid, std::string_view program, int partition, unsigned int size, process_state_t state) override {
+        current.push_back({pid, partition, intern(program), size, static_cast<uint32_t>(state)});
+    }
+    using event_log_t::snapshot_row;
+
+    //Writes the snapshot as runs of unchanged rows and the rows that are new or changed
+    void snapshot_end() override {
+        PROFILE_SCOPE(phase_t::LOG);
+        if(changes_only) {
+            end_changes();
+            return;
+        }
+        bool checkpoint = (snapshot_fields[0] & 0xFF) == DELTA_CHECKPOINT;
+        operations.clear();
+        uint32_t count = 0;
+        int32_t copy_end = -1;      //!< the row after the last one copied, to extend the run
+        for(const status_row_t& row : current) {
+            int32_t found = !checkpoint && row.pid >= 0 && static_cast<size_t>(row.pid) < previous_row.size() ? previous_row[row.pid] : -1;
+            if(found >= 0 && previous[found] == row) {
+                if(found == copy_end) {
+                    operations[operations.size() - 1]++;
+                } else {
+                    operations.insert(operations.end(), {DELTA_COPY, static_cast<uint32_t>(found), 1});
+                    count++;
+                }
+                copy_end = found + 1;
+            } else {
+                operations.insert(operations.end(), {DELTA_ROW | row.state << 8, static_cast<uint32_t>(row.pid), static_cast<uint32_t>(row.partition), row.program, row.size});
+                count++;
+                copy_end = -1;
+            }
+        }
+
+        write_bytes(snapshot_fields.data(), sizeof(snapshot_fields));
+        write_bytes(&count, sizeof(count));
+        write_bytes(operations.data(), operations.size() * sizeof(uint32_t));
+        snapshots++;
+
+        //the rows just written are what the next snapshot is compared with
+        for(const status_row_t& row : previous) {
+            if(row.pid >= 0 && static_cast<size_t>(row.pid) < previous_row.size()) {
+                previous_row[row.pid] = -1;
+            }
+        }
+        previous.swap(current);
+        for(size_t r = 0; r < previous.size(); r++) {
+            int32_t pid = previous[r].pid;
+            if(pid >= 0) {
+                if(static_cast<size_t>(pid) >= previous_row.size()) {
+                    previous_row.resize(pid + 1, -1);
+                }
+                previous_row[pid] = r;
+            }
+        }
+    }
+
+    //Writes the names, the checkpoint index and the footer
+    void finish() {
+        if(finished) {
+            return;
+        }
+        finished = true;
+
+        status_delta_footer_t footer{};
+        footer.names_offset = offset;
+        uint32_t count = names.size();
+        write_bytes(&count, sizeof(count));
+        for(const std::string& name : names) {
+            uint32_t length = name.size();
+            write_bytes(&length, sizeof(length));
+            write_bytes(name.data(), length);
+            static const char zeros[4] = {};
+            write_bytes(zeros, (4 - length % 4) % 4);
+        }
+
+        footer.index_offset = offset;
+        count = checkpoints.size();
+        write_bytes(&count, sizeof(count));
+        write_bytes(checkpoints.data(), checkpoints.size() * sizeof(status_checkpoint_t));
+
+        footer.snapshots = snapshots;
+        std::memcpy(footer.magic, STATUS_DELTA_MAGIC, sizeof(footer.magic));
+        write_bytes(&footer, sizeof(footer));
+        output.flush();
+    }
+
+private:
+    static constexpr uint32_t DROPPED_ROW = UINT32_MAX;    //!< the state of a row of 'previous' about to be taken out
+
+    //Writes a snapshot given as the rows that changed (see snapshot_changes) and
+    //applies them to 'previous', which stays the table the next snapshot is compared with
+    void end_changes() {
+        bool checkpoint = (snapshot_fields[0] & 0xFF) == DELTA_CHECKPOINT;
+        operations.clear();
+        uint32_t count = 0;
+        uint32_t next = 0;      //!< the first row of 'previous' not yet copied, changed or dropped
+        bool dropped = false;
+        auto copy_until = [&](uint32_t end) {
+            if(end > next && !checkpoint) {
+                operations.insert(operations.end(), {DELTA_COPY, next, end - next});
+                count++;
+            }
+            next = end;
+        };
+        auto write_row = [&](const status_row_t& row) {
+            operations.insert(operations.end(), {DELTA_ROW | row.state << 8, static_cast<uint32_t>(row.pid), static_cast<uint32_t>(row.partition), row.program, row.size});
+            count++;
+        };
+
+        const uint32_t rows = previous.size();
+        for(const status_row_t& row : current) {
+            int32_t found = row.pid >= 0 && static_cast<size_t>(row.pid) < previous_row.size() ? previous_row[row.pid] : -1;
+            bool ended = row.state == static_cast<uint32_t>(process_state_t::TERMINATED);
+            if(found < 0) {
+                if(ended) {
+                    continue;   //it was never in a snapshot
+                }
+                copy_until(rows);
+                if(!checkpoint) {
+                    write_row(row);
+                }
+                if(row.pid >= 0) {
+                    if(static_cast<size_t>(row.pid) >= previous_row.size()) {
+                        previous_row.resize(row.pid + 1, -1);
+                    }
+                    previous_row[row.pid] = previous.size();
+                }
+                previous.push_back(row);
+            } else if(ended) {
+                copy_until(found);
+                next = found + 1;
+                previous_row[row.pid] = -1;
+                previous[found].state = DROPPED_ROW;
+                dropped = true;
+            } else if(!(previous[found] == row)) {
+                copy_until(found);
+                next = found + 1;
+                if(!checkpoint) {
+                    write_row(row);
+                }
+                previous[found] = row;
+            }
+        }
+        copy_until(rows);
+
+        //the rows of the processes that ended go, and the rows after them move up
+        if(dropped) {
+            size_t kept = 0;
+            for(const status_row_t& row : previous) {
+                if(row.state != DROPPED_ROW) {
+                    if(row.pid >= 0) {
+                        previous_row[row.pid] = kept;
+                    }
+                    previous[kept++] = row;
+                }
+            }
+            previous.resize(kept);
+        }
+        //a checkpoint holds the whole table
+        if(checkpoint) {
+            for(const status_row_t& row : previous) {
+                write_row(row);
+            }
+        }
+
+        write_bytes(snapshot_fields.data(), sizeof(snapshot_fields));
+        write_bytes(&count, sizeof(count));
+        write_bytes(operations.data(), operations.size() * sizeof(uint32_t));
+        snapshots++;
+    }
+
+    uint32_t intern(std::string_view name) {
+        auto found = name_ids.find(name);
+        if(found != name_ids.end()) {
+            return found->second;
+        }
+        uint32_t id = names.size();
+        names.emplace_back(name);
+        name_ids.emplace(names.back(), id);
+        return id;
+    }
+
+    void write_bytes(const void* data, size_t size) {
+        output.write(std::string_view(static_cast<const char*>(data), size));
+        offset += size;
+    }
+};
+
+//A delta status log read back: its names and checkpoints, and the snapshots still encoded
+struct status_delta_t {
+    std::string_view                    contents;
+    std::vector<std::string_view>       names;
+    std::vector<status_checkpoint_t>    checkpoints;
+    uint64_t                            snapshots_end = 0;  //!< offset of the names, where the snapshots stop
+};
+
+/**
+ * \brief read the header, names and checkpoint index of a delta status log
+ *
+ * @param contents the whole log (e.g. a mapped file's contents)
+ * @param delta filled with the names and checkpoints
+ * @param error why the log could not be read
+ * @return false if the log is not a valid delta status log
+ *
+ */
+bool open_status_delta(std::string_view contents, status_delta_t& delta, std::string& error) {
+    status_delta_header_t header;
+    status_delta_footer_t footer;
+    if(contents.size() < sizeof(header) + sizeof(footer)) {
+        error = "truncated log";
+        return false;
+    }
+    std::memcpy(&header, contents.data(), sizeof(header));
+    std::memcpy(&footer, contents.data() + contents.size() - sizeof(footer), sizeof(footer));
+    if(std::memcmp(header.magic, STATUS_DELTA_MAGIC, sizeof(header.magic)) != 0
+       || std::memcmp(footer.magic, STATUS_DELTA_MAGIC, sizeof(footer.magic)) != 0) {
+        error = "not a complete delta status log";
+        return false;
+    }
+    if(header.byte_order != STATUS_DELTA_BYTE_ORDER || header.version != STATUS_DELTA_VERSION) {
+        error = "unsupported byte order or version";
+        return false;
+    }
+
+    uint64_t end = contents.size() - sizeof(footer);
+    if(footer.names_offset < sizeof(header) || footer.names_offset > footer.index_offset || footer.index_offset > end) {
+        error = "bad footer";
+        return false;
+    }
+
+    delta = status_delta_t{contents, {}, {}, footer.names_offset};
+    uint64_t offset = footer.names_offset;
+    auto read_u32 = [&](uint32_t& value, uint64_t limit) {
+        if(limit - offset < sizeof(value)) {
+            return false;
+        }
+        std::memcpy(&value, contents.data() + offset, sizeof(value));
+        offset += sizeof(value);
+        return true;
+    };
+
+    uint32_t count;
+    if(!read_u32(count, footer.index_offset)) {
+        error = "truncated names";
+        return false;
+    }
+    for(uint32_t i = 0; i < count; i++) {
+        uint32_t length;
+        if(!read_u32(length, footer.index_offset) || footer.index_offset - offset < ((uint64_t(length) + 3) & ~uint64_t(3))) {
+            error = "truncated names";
+            return false;
+        }
+        delta.names.emplace_back(contents.data() + offset, length);
+        offset += (uint64_t(length) + 3) & ~uint64_t(3);
+    }
+
+    offset = footer.index_offset;
+    if(!read_u32(count, end) || (end - offset) / sizeof(status_checkpoint_t) < count) {
+        error = "truncated index";
+        return false;
+    }
+    delta.checkpoints.resize(count);
+    std::memcpy(delta.checkpoints.data(), contents.data() + offset, count * sizeof(status_checkpoint_t));
+    for(const status_checkpoint_t& checkpoint : delta.checkpoints) {
+        if(checkpoint.offset < sizeof(header) || checkpoint.offset >= footer.names_offset) {
+            error = "bad checkpoint";
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * \brief replay the snapshots of a delta status log
+ *
+ * Rebuilds every snapshot from 'start' on, in full, and sends the ones selected
+ * to another log: replaying all of them into a text_event_log_t renders the
+ * system_status.txt the run would have written.
+ *
+ * @param delta the log (see open_status_delta)
+ * @param start offset of the snapshot to start from: a checkpoint, or the first snapshot
+ * @param until stop at the first snapshot later than this time
+ * @param last_only send only the last snapshot rebuilt (the table at 'until')
+ * @param log where the snapshots go
+ * @param error why the log could not be read
+ * @return the number of snapshots rebuilt, or -1 if the log is not valid
+ *
+ */
+int replay_status_delta(const status_delta_t& delta, uint64_t start, int until, bool last_only, event_log_t& log, std::string& error) {
+    const char* data = delta.contents.data();
+    uint64_t offset = start;
+    auto read_words = [&](uint32_t* words, size_t count) {
+        if((delta.snapshots_end - offset) / sizeof(uint32_t) < count) {
+            return false;
+        }
+        std::memcpy(words, data + offset, count * sizeof(uint32_t));
+        offset += count * sizeof(uint32_t);
+        return true;
+    };
+    auto name_of = [&](uint32_t id, std::string_view& name) {
+        if(id >= delta.names.size()) {
+            return false;
+        }
+        name = delta.names[id];
+        return true;
+    };
+    auto send = [&](const uint32_t* fields, const std::vector<status_row_t>& rows) {
+        std::string_view program;
+        name_of(fields[3], program);
+        log.snapshot(fields[1], static_cast<opcode_t>(fields[0] >> 8 & 0xFF), fields[2], program);
+        for(const status_row_t& row : rows) {
+            log.snapshot_row(row.pid, delta.names[row.program], row.partition, row.size, static_cast<process_state_t>(row.state));
+        }
+        log.snapshot_end();
+    };
+
+    std::vector<status_row_t> previous, current;
+    uint32_t fields[5] = {};    //!< of the last snapshot rebuilt
+    int rebuilt = 0;
+    while(offset < delta.snapshots_end) {
+        uint32_t next[5];
+        if(!read_words(next, 5)) {
+            error = "truncated snapshot";
+            return -1;
+        }
+        uint8_t tag = next[0] & 0xFF;
+        std::string_view program;
+        if((tag != DELTA_SNAPSHOT && tag != DELTA_CHECKPOINT) || (rebuilt == 0 && tag != DELTA_CHECKPOINT)
+           || (next[3] != NO_INDEX && !name_of(next[3], program))) {
+            error = "bad snapshot at offset " + std::to_string(offset - sizeof(next));
+            return -1;
+        }
+        if(static_cast<int32_t>(next[1]) > until) {
+            break;
+        }
+
+        current.clear();
+        for(uint32_t i = 0; i < next[4]; i++) {
+            uint32_t operation[5];
+            if(!read_words(operation, 1)) {
+                error = "truncated snapshot";
+                return -1;
+            }
+            if((operation[0] & 0xFF) == DELTA_COPY && tag == DELTA_SNAPSHOT && read_words(operation + 1, 2)
+               && operation[1] <= previous.size() && operation[2] <= previous.size() - operation[1]) {
+                current.insert(current.end(), previous.begin() + operation[1], previous.begin() + operation[1] + operation[2]);
+            } else if((operation[0] & 0xFF) == DELTA_ROW && read_words(operation + 1, 4) && name_of(operation[3], program)
+                      && (operation[0] >> 8) <= static_cast<uint32_t>(process_state_t::TERMINATED)) {
+                current.push_back({static_cast<int32_t>(operation[1]), static_cast<int32_t>(operation[2]), operation[3], operation[4], operation[0] >> 8});
+            } else {
+                error = "bad operation at offset " + std::to_string(offset);
+                return -1;
+            }
+        }
+
+        std::memcpy(fields, next, sizeof(fields));
+        rebuilt++;
+        if(!last_only) {
+            send(fields, current);
+        }
+        previous.swap(current);
+    }
+
+    if(last_only && rebuilt > 0) {
+        send(fields, previous);
+    }
+    return rebuilt;
+}
+
+//Offset to start reading from to rebuild the table at 'time': the last checkpoint at or before it
+uint64_t status_delta_seek(const status_delta_t& delta, int time) {
+    auto after = std::upper_bound(delta.checkpoints.begin(), delta.checkpoints.end(), time,
+                                  [](int t, const status_checkpoint_t& checkpoint) { return t < checkpoint.time; });
+    return after == delta.checkpoints.begin() ? sizeof(status_delta_header_t) : std::prev(after)->offset;
+}
+
+#endif
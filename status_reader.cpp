@@ -0,0 +1,81 @@
+/**
+ *
+ * @file status_reader.cpp
+ * Rebuilds the system status from a delta status log (written with
+ * --status-format=delta): the whole system_status.txt the simulator would have
+ * written, or only the table at a given time, read from the last checkpoint
+ * before it.
+ *
+ */
+
+#include "status_delta.hpp"
+#include "mapped_file.hpp"
+
+#include<charconv>
+
+//Writes the log to the standard output
+struct stdout_sink_t : output_sink_t {
+    ~stdout_sink_t() override {
+        flush();
+    }
+
+protected:
+    void emit(const char* data, size_t size) override {
+        std::cout.write(data, size);
+    }
+};
+
+int main(int argc, char** argv) {
+    if(argc != 2 && argc != 3) {
+        std::cout << "ERROR!\nExpected 1 or 2 arguments, received " << argc - 1 << std::endl;
+        std::cout << "To rebuild the status, do: ./status_reader <system_status.delta> [<time>]" << std::endl;
+        exit(1);
+    }
+
+    int time = INT32_MAX;
+    if(argc == 3) {
+        std::string_view value(argv[2]);
+        auto result = std::from_chars(value.data(), value.data() + value.size(), time);
+        if(result.ec != std::errc() || result.ptr != value.data() + value.size()) {
+            std::cerr << "Error: Invalid time '" << value << "'" << std::endl;
+            exit(1);
+        }
+    }
+
+    mapped_file_t file(argv[1]);
+    if(!file.is_open()) {
+        std::cerr << "Error: Unable to open file: " << argv[1] << std::endl;
+        exit(1);
+    }
+
+    std::string error;
+    status_delta_t delta;
+    if(!open_status_delta(file.contents(), delta, error)) {
+        std::cerr << "Error: " << argv[1] << ": " << error << std::endl;
+        exit(1);
+    }
+
+    //only the status is rendered, so there are no events and no vectors
+    null_sink_t execution;
+    stdout_sink_t system_status;
+    vector_table_t vectors = make_vector_table({});
+    text_event_log_t log(execution, system_status, vectors);
+    int rebuilt;
+    if(argc == 2) {
+        rebuilt = replay_status_delta(delta, sizeof(status_delta_header_t), time, false, log, error);
+    } else {
+        rebuilt = replay_status_delta(delta, status_delta_seek(delta, time), time, true, log, error);
+    }
+    system_status.flush();
+
+    if(rebuilt < 0) {
+        std::cerr << "Error: " << argv[1] << ": " << error << std::endl;
+        exit(1);
+    }
+    if(rebuilt == 0 && argc == 3) {
+        std::cerr << "Error: no system status at or before time " << time << std::endl;
+        exit(1);
+    }
+
+    return 0;
+}
@@ -0,0 +1,41 @@
+/**
+ *
+ * @file trace_convert.cpp
+ * Converts a text trace (and every program it EXECs) into a binary trace the
+ * simulator can map and run directly (see binary_trace.hpp).
+ *
+ */
+
+#include "binary_trace.hpp"
+
+int main(int argc, char** argv) {
+    if(argc < 3 || argc > 4) {
+        std::cout << "ERROR!\nExpected 2 or 3 arguments, received " << argc - 1 << std::endl;
+        std::cout << "To convert a trace, do: ./trace_convert <your_trace_file.txt> <output_file.bin> [<program_prefix>]" << std::endl;
+        exit(1);
+    }
+
+    if(!std::ifstream(argv[1]).is_open()) {
+        std::cerr << "Error: Unable to open file: " << argv[1] << std::endl;
+        exit(1);
+    }
+    if(is_binary_trace(argv[1])) {
+        std::cerr << "Error: " << argv[1] << " is already a binary trace" << std::endl;
+        exit(1);
+    }
+
+    compiled_trace_t compiled = compile_trace(argv[1], argc == 4 ? argv[3] : "");
+    if(!write_binary_trace(compiled, argv[2])) {
+        std::cerr << "Error: Unable to write file: " << argv[2] << std::endl;
+        exit(1);
+    }
+
+    size_t instructions = 0;
+    for(const auto& program : compiled.programs) {
+        instructions += program.code().size();
+    }
+    std::cout << argv[1] << " -> " << argv[2] << ": " << compiled.programs.size() << " program(s), "
+              << instructions << " instruction(s), " << compiled.views.size() << " view(s)" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,189 @@
+/**
+ *
+ * @file whatif.cpp
+ * Runs a trace once, taking checkpoints as it goes, then reruns it once per line
+ * of a changes file with the tables changed as the line says. Each rerun starts
+ * from the last checkpoint before the first instruction the change can affect:
+ * the logs up to there are copied from the first run, and only the rest of the
+ * trace is simulated again.
+ *
+ */
+
+#include "sim_options.hpp"
+#include "checkpoint.hpp"
+#include "mapped_file.hpp"
+
+#include<chrono>
+
+double elapsed_ms(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+//The PCB of init, loaded into memory the way run_simulation does it
+PCB make_init(machine_t& machine) {
+    PCB init(0, -1, "init", 1, -1);
+    if(!allocate_memory(machine, &init)) {
+        std::cerr << "ERROR! Memory allocation failed!" << std::endl;
+    }
+    return init;
+}
+
+int main(int argc, char** argv) {
+    //the what-if options are taken out; the rest are the simulator's
+    std::string changes_file;
+    uint64_t interval = DEFAULT_CHECKPOINT_INTERVAL;
+    size_t limit = DEFAULT_CHECKPOINT_LIMIT;
+    bool verify = false;
+    std::vector<char*> arguments;
+    for(int i = 0; i < argc; i++) {
+        std::string_view argument(argv[i]);
+        if(i >= 5 && argument.substr(0, 10) == "--changes=") {
+            changes_file = argument.substr(10);
+        } else if(i >= 5 && argument.substr(0, 22) == "--checkpoint-interval=") {
+            int value = 0;
+            if(!parse_positive(argument.substr(22), value)) {
+                std::cerr << "Error: Invalid checkpoint interval '" << argument.substr(22) << "'" << std::endl;
+                exit(1);
+            }
+            interval = value;
+        } else if(i >= 5 && argument.substr(0, 18) == "--max-checkpoints=") {
+            int value = 0;
+            if(!parse_positive(argument.substr(18), value)) {
+                std::cerr << "Error: Invalid checkpoint count '" << argument.substr(18) << "'" << std::endl;
+                exit(1);
+            }
+            limit = value;
+        } else if(i >= 5 && argument == "--verify") {
+            verify = true;
+        } else {
+            arguments.push_back(argv[i]);
+        }
+    }
+    if(arguments.size() < 5 || changes_file.empty()) {
+        std::cout << "ERROR!\nExpected 4 arguments and --changes=<file>" << std::endl;
+        std::cout << "To run what-ifs, do: ./whatif <your_trace_file.txt> <your_vector_table.txt> <your_device_table.txt> <your_external_files.txt> --changes=<changes.txt> [--checkpoint-interval=<instructions>] [--max-checkpoints=<count>] [--verify] [options]" << std::endl;
+        exit(1);
+    }
+
+    auto [vectors, delays, external_files] = parse_args(arguments.size(), arguments.data());
+    sim_options_t options = parse_options(arguments.size(), arguments.data());
+    if(options.scheduled || options.log_format != log_format_t::TEXT || options.status_format != status_format_t::TEXT) {
+        std::cerr << "Error: what-if runs use the default engine and the text logs (no --scheduler, --log-format or --status-format)" << std::endl;
+        exit(1);
+    }
+
+    simulation_context_t context{make_vector_table(vectors), std::move(delays), std::move(external_files), {}};
+    context.catalog = make_program_catalog(context.external_files);
+
+    compiled_trace_t compiled;
+    try {
+        compiled = load_trace(arguments[1]);
+        check_table_numbers(compiled, context);
+    } catch(const std::runtime_error& error) {
+        std::cerr << "Error: " << error.what() << std::endl;
+        exit(1);
+    }
+
+    //The first run, with its checkpoints
+    uint64_t steps;
+    double base_ms;
+    file_sink_t execution("execution.txt");
+    file_sink_t system_status("system_status.txt");
+    if(!execution.is_open() || !system_status.is_open()) {
+        exit(1);
+    }
+    checkpoint_recorder_t checkpoints(compiled, execution, system_status, interval, limit);
+    {
+        auto start = std::chrono::steady_clock::now();
+        machine_t machine(options.allocation_policy, options.partition_sizes);
+        simulator_state_t state = start_trace(compiled, ROOT_PROGRAM, 0, make_init(machine));
+        text_event_log_t log(execution, system_status, context.vectors);
+        resume_trace(compiled, state, context, machine, log, &checkpoints);
+        execution.close();
+        system_status.close();
+        steps = state.steps;
+        base_ms = elapsed_ms(start);
+    }
+    std::cout << "Base run: " << steps << " instructions, " << checkpoints.checkpoints.size() << " checkpoints (every " << checkpoints.interval << "), "
+              << std::fixed << std::setprecision(1) << base_ms << " ms; output in execution.txt and system_status.txt" << std::endl;
+
+    mapped_file_t base_execution("execution.txt");
+    mapped_file_t base_status("system_status.txt");
+    std::ifstream changes(changes_file);
+    if(!changes.is_open() || !base_execution.is_open() || !base_status.is_open()) {
+        std::cerr << "Error: Unable to open file: " << (changes.is_open() ? "execution.txt" : changes_file) << std::endl;
+        exit(1);
+    }
+
+    //One rerun per line of changes
+    std::string line;
+    int variant = 0;
+    bool all_same = true;
+    while(std::getline(changes, line)) {
+        if(line.empty() || line[0] == '#') {
+            continue;
+        }
+        variant++;
+
+        simulation_context_t changed = context;
+        uint64_t first = NEVER_USED;
+        for(const std::string& text : split_delim(line, ";")) {
+            whatif_change_t change;
+            if(!parse_whatif_change(text, change) || !apply_whatif_change(changed, change)) {
+                std::cerr << "Error: Invalid change '" << text << "' in " << changes_file << std::endl;
+                exit(1);
+            }
+            first = std::min(first, checkpoints.first_affected(change));
+        }
+
+        std::string prefix = "whatif" + std::to_string(variant) + "_";
+        auto start = std::chrono::steady_clock::now();
+        uint64_t resumed_at = steps;
+        {
+            file_sink_t variant_execution(prefix + "execution.txt");
+            file_sink_t variant_status(prefix + "system_status.txt");
+            if(!variant_execution.is_open() || !variant_status.is_open()) {
+                exit(1);
+            }
+            if(first == NEVER_USED) {
+                //nothing the run used changed: the logs are the same
+                variant_execution.write(base_execution.contents());
+                variant_status.write(base_status.contents());
+            } else {
+                const simulation_checkpoint_t& checkpoint = checkpoints.restore_point(first);
+                resumed_at = checkpoint.state.steps;
+                variant_execution.write(base_execution.contents().substr(0, checkpoint.execution_size));
+                variant_status.write(base_status.contents().substr(0, checkpoint.status_size));
+
+                simulator_state_t state = checkpoint.state;
+                machine_t machine = checkpoint.machine;
+                text_event_log_t log(variant_execution, variant_status, changed.vectors);
+                resume_trace(compiled, state, changed, machine, log);
+            }
+        }
+        double variant_ms = elapsed_ms(start);
+
+        std::cout << prefix << ": " << line << ": resumed at instruction " << resumed_at << " of " << steps
+                  << " (" << (steps ? 100.0 * (steps - resumed_at) / steps : 0.0) << "% rerun), " << variant_ms << " ms";
+
+        //the same run from the beginning, to compare with
+        if(verify) {
+            memory_sink_t full_execution;
+            memory_sink_t full_status;
+            auto full_start = std::chrono::steady_clock::now();
+            machine_t machine(options.allocation_policy, options.partition_sizes);
+            text_event_log_t log(full_execution, full_status, changed.vectors);
+            simulate_trace(compiled, ROOT_PROGRAM, 0, changed, machine, make_init(machine), log);
+            double full_ms = elapsed_ms(full_start);
+
+            mapped_file_t variant_execution(prefix + "execution.txt");
+            mapped_file_t variant_status(prefix + "system_status.txt");
+            bool same = variant_execution.contents() == full_execution.str() && variant_status.contents() == full_status.str();
+            all_same = all_same && same;
+            std::cout << "; full rerun " << full_ms << " ms, " << (same ? "same logs" : "DIFFERENT logs");
+        }
+        std::cout << std::endl;
+    }
+
+    return all_same ? 0 : 1;
+}